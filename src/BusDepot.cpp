@@ -1,6 +1,8 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
 #include "gtgDSP.hpp"
+#include "gtgAudition.hpp"
+#include "gtgStations.hpp"
 
 struct BusDepot : Module {
 	enum ParamIds {
@@ -28,8 +30,6 @@ struct BusDepot : Module {
 	};
 	enum LightIds {
 		ENUMS(ON_LIGHT, 2),
-		ENUMS(LEFT_LIGHTS, 11),
-		ENUMS(RIGHT_LIGHTS, 11),
 		NUM_LIGHTS
 	};
 
@@ -47,11 +47,17 @@ struct BusDepot : Module {
 	const int level_speed = 26;   // for level cv filter
 	float peak_left = 0.f;
 	float peak_right = 0.f;
+	std::atomic<float> vu_levels[2] = {{0.f}, {0.f}};   // snapshots for the vu meter widgets
+	std::atomic<float> vu_peaks[2] = {{0.f}, {0.f}};
 	bool level_cv_filter = true;
 	int fade_cv_mode = 0;
 	bool auto_override = false;
 	bool auditioned = false;
+	AuditionFollower audition{depot_auditions};
 	int audition_mode = 0;
+	int bus_rig = 0;
+	int receive_station = -1;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
@@ -85,7 +91,10 @@ struct BusDepot : Module {
 
 	void process(const ProcessArgs &args) override {
 
-		// check default theme and reset vu meters
+		// audition changes apply on the same frame in every depot of the audition group
+		bool audition_changed = audition.process(args.frame);
+
+		// reset vu meters
 		if (housekeeping_divider.process()) {
 			vu_meters[0].v = 0.f;
 			vu_meters[1].v = 0.f;
@@ -97,8 +106,8 @@ struct BusDepot : Module {
 		case LongPressButton::NO_PRESS:
 			break;
 		case LongPressButton::SHORT_PRESS:
-			if (audition_depot) {
-				audition_depot = false;   // single click turns off auditions
+			if (audition.active) {
+				audition.set(false, args.frame);   // single click turns off auditions
 			} else {
 				if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL) {   // bypass fades with ctrl click
 					auto_override = true;
@@ -124,7 +133,7 @@ struct BusDepot : Module {
 			break;
 		case LongPressButton::LONG_PRESS:   // long press to audition
 
-			audition_depot = true;   // all depots to audition mode
+			audition.set(true, args.frame);   // all depots to audition mode
 
 			if (auditioned) {
 				auditioned = false;
@@ -144,7 +153,7 @@ struct BusDepot : Module {
 
 		// process cv trigger
 		if (on_cv_trigger.process(inputs[ON_CV_INPUT].getVoltage())) {
-			if (!audition_depot) {
+			if (!audition.active) {
 				auto_override = false;   // do not override automation
 				depot_fader.on = !depot_fader.on;
 			}
@@ -152,10 +161,9 @@ struct BusDepot : Module {
 
 		depot_fader.process();
 
-		// process fade states and on light
-		if (audition_divider.process()) {
-
-			if (audition_depot) {   // all depots are in audition state
+		// apply audition changes on the same frame as other depots
+		if (audition_changed) {
+			if (audition.active) {   // all depots are in audition state
 
 				// bypass all fade automation
 				auto_override = true;
@@ -194,6 +202,10 @@ struct BusDepot : Module {
 				// turn off auditions
 				auditioned = false;
 			}
+		}
+
+		// process fade states and on light
+		if (audition_divider.process()) {
 
 			// process fade speed changes if turning knobs
 			if (!auto_override) {
@@ -230,7 +242,7 @@ struct BusDepot : Module {
 
 			// set lights
 			if (depot_fader.getFade() == depot_fader.getGain()) {
-				if (audition_depot) {
+				if (audition.active) {
 					lights[ON_LIGHT + 0].value = 1.f;   // yellow when auditioned
 					lights[ON_LIGHT + 1].value = 1.f;
 				} else {
@@ -250,6 +262,13 @@ struct BusDepot : Module {
 
 		// process sound
 		float summed_out[2] = {0.f, 0.f};
+		float bus_in[6] = {};
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);   // the other rig passes through untouched
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		if (receive_station >= 0 && receive_station != station_publisher.station) {   // add buses published to a station, never our own
+			bus_channels = std::max(bus_channels, readStation(station_publisher.network, receive_station, args.frame, bus_frame));
+		}
 		if (depot_fader.getFade() > 0.f) {   // don't need to process sound when silent
 
 			// get param levels
@@ -275,36 +294,33 @@ struct BusDepot : Module {
 				}
 			}
 
-			// bus inputs with levels
-			float bus_in[6] = {};
+			// get the selected rig
+			bus_frame.getRig(bus_rig, bus_in);
 
 			// get blue and orange buses with levels
 			for (int c = 0; c < 4; c++) {
-				bus_in[c] = inputs[BUS_INPUT].getPolyVoltage(c) * master_level * exp_fade;
+				bus_in[c] *= master_level * exp_fade;
 			}
 
 			// get red levels and add aux inputs
 			for (int c = 4; c < 6; c++) {
-				bus_in[c] = (stereo_in[c - 4] + inputs[BUS_INPUT].getPolyVoltage(c)) * master_level * exp_fade;
-			}
-
-			// set bus outputs
-			for (int c = 0; c < 6; c++) {
-				outputs[BUS_OUTPUT].setVoltage(bus_in[c], c);
+				bus_in[c] = (stereo_in[c - 4] + bus_in[c]) * master_level * exp_fade;
 			}
 
 			// sum stereo mix for stereo outputs and light levels
 			for (int c = 0; c < 2; c++) {
 				summed_out[c] = bus_in[c] + bus_in[c + 2] + bus_in[c + 4];
 			}
-
-			// set stereo mix out
-			outputs[LEFT_OUTPUT].setVoltage(summed_out[0]);
-			outputs[RIGHT_OUTPUT].setVoltage(summed_out[1]);
 		}
 
-		// set three stereo bus outputs on bus out
-		outputs[BUS_OUTPUT].setChannels(6);
+		// set the selected rig, silent when faded out
+		bus_frame.setRig(bus_rig, bus_in);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
+
+		// set stereo mix out
+		outputs[LEFT_OUTPUT].setVoltage(summed_out[0]);
+		outputs[RIGHT_OUTPUT].setVoltage(summed_out[1]);
 
 		// hit peak lights accurately by polling every sample
 		if (summed_out[0] > 10.f) peak_left = 1.f;
@@ -319,45 +335,46 @@ struct BusDepot : Module {
 
 		if (light_divider.process()) {   // set lights and fade speed infrequently
 
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
-
 			// make peak lights stay on when hit
 			if (peak_left > 0) peak_left -= 120.f / args.sampleRate; else peak_left = 0.f;
 			if (peak_right > 0) peak_right -= 120.f / args.sampleRate; else peak_right = 0.f;
-			lights[LEFT_LIGHTS + 0].setBrightness(peak_left);
-			lights[RIGHT_LIGHTS + 0].setBrightness(peak_right);
+			vu_peaks[0].store(peak_left, std::memory_order_relaxed);
+			vu_peaks[1].store(peak_right, std::memory_order_relaxed);
 
-			// green and yellow lights
-			for (int i = 1; i < 6; i++) {
-				lights[LEFT_LIGHTS + i].setBrightness(vu_meters[0].getBrightness((-3 * i), -3 * (i - 1)));
-				lights[RIGHT_LIGHTS + i].setBrightness(vu_meters[1].getBrightness((-3 * i), -3 * (i - 1)));
+			// snapshot the vu meters
+			for (int c = 0; c < 2; c++) {
+				vu_levels[c].store(vu_meters[c].v, std::memory_order_relaxed);
 			}
-			lights[LEFT_LIGHTS + 6].setBrightness(vu_meters[0].getBrightness(-19, -15));
-			lights[RIGHT_LIGHTS + 6].setBrightness(vu_meters[1].getBrightness(-19, -15));
-			lights[LEFT_LIGHTS + 7].setBrightness(vu_meters[0].getBrightness(-24, -19));
-			lights[RIGHT_LIGHTS + 7].setBrightness(vu_meters[1].getBrightness(-24, -19));
-			lights[LEFT_LIGHTS + 8].setBrightness(vu_meters[0].getBrightness(-30, -24));
-			lights[RIGHT_LIGHTS + 8].setBrightness(vu_meters[1].getBrightness(-30, -24));
-			lights[LEFT_LIGHTS + 9].setBrightness(vu_meters[0].getBrightness(-36, -28));
-			lights[RIGHT_LIGHTS + 9].setBrightness(vu_meters[1].getBrightness(-36, -28));
-			lights[LEFT_LIGHTS + 10].setBrightness(vu_meters[0].getBrightness(-48, -36));
-			lights[RIGHT_LIGHTS + 10].setBrightness(vu_meters[1].getBrightness(-48, -36));
 		}
 	}
 
+	// pass the bus chain through when bypassed, stereo outs get the unity mix of the selected rig
+	void processBypass(const ProcessArgs &args) override {
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.store(outputs[BUS_OUTPUT], busChannels(inputs[BUS_INPUT], 0));
+
+		float bus_in[6];
+		bus_frame.getRig(bus_rig, bus_in);
+		outputs[LEFT_OUTPUT].setVoltage(bus_in[0] + bus_in[2] + bus_in[4]);
+		outputs[RIGHT_OUTPUT].setVoltage(bus_in[1] + bus_in[3] + bus_in[5]);
+	}
+
 	// save on button state
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 		json_object_set_new(rootJ, "input_on", json_integer(depot_fader.on));
 		json_object_set_new(rootJ, "level_cv_filter", json_integer(level_cv_filter));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
+		json_object_set_new(rootJ, "receive_station", json_integer(receive_station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
 		json_object_set_new(rootJ, "fade_cv_mode", json_integer(fade_cv_mode));
-		json_object_set_new(rootJ, "audition_depot", json_integer(audition_depot));
+		json_object_set_new(rootJ, "audition_depot", json_integer(audition.isActive()));
+		json_object_set_new(rootJ, "audition_group", json_integer(audition.group));
 		json_object_set_new(rootJ, "auditioned", json_integer(auditioned));
 		json_object_set_new(rootJ, "temped", json_integer(depot_fader.temped));
 		json_object_set_new(rootJ, "audition_mode", json_integer(audition_mode));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
 		return rootJ;
 	}
@@ -377,8 +394,13 @@ struct BusDepot : Module {
 		} else {
 			if (input_onJ) use_default_theme = false;   // do not change existing patches
 		}
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
+		json_t *receive_stationJ = json_object_get(rootJ, "receive_station");
+		if (receive_stationJ) receive_station = json_integer_value(receive_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
 		json_t *fade_cv_modeJ = json_object_get(rootJ, "fade_cv_mode");
 		if (fade_cv_modeJ) {
 			fade_cv_mode = json_integer_value(fade_cv_modeJ);
@@ -387,11 +409,13 @@ struct BusDepot : Module {
 				params[FADE_IN_PARAM].setValue(params[FADE_PARAM].getValue());   // same behavior on patches saved before fade in knob existed
 			}
 		}
+		json_t *audition_groupJ = json_object_get(rootJ, "audition_group");
+		if (audition_groupJ) audition.setGroup(json_integer_value(audition_groupJ));
 		json_t *audition_depotJ = json_object_get(rootJ, "audition_depot");
 		if (audition_depotJ) {
-			audition_depot = json_integer_value(audition_depotJ);
+			audition.set(json_integer_value(audition_depotJ), APP->engine->getFrame());
 		} else {
-			audition_depot = false;   // off because patch saved before audition
+			audition.set(false, APP->engine->getFrame());   // off because patch saved before audition
 		}
 		json_t *auditionedJ = json_object_get(rootJ, "auditioned");
 		if (auditionedJ) auditioned = json_integer_value(auditionedJ);
@@ -399,6 +423,8 @@ struct BusDepot : Module {
 		if (tempedJ) depot_fader.temped = json_integer_value(tempedJ);
 		json_t *audition_modeJ = json_object_get(rootJ, "audition_mode");
 		if (audition_modeJ) audition_mode = json_integer_value(audition_modeJ);
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
 	}
 
 	void onSampleRateChange() override {
@@ -416,28 +442,22 @@ struct BusDepot : Module {
 		level_cv_filter = true;
 		fade_cv_mode = 0;
 		audition_mode = 0;
-		audition_depot = false;
+		audition.set(false, APP->engine->getFrame());
+		audition.setGroup(0);
+		bus_rig = 0;
+		station_publisher.station = -1;
+		receive_station = -1;
 	}
 };
 
 
 struct BusDepotWidget : ModuleWidget {
-	SvgPanel* night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	BusDepotWidget(BusDepot *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/BusDepot.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/BusDepot_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("BusDepot", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
@@ -462,23 +482,9 @@ struct BusDepotWidget : ModuleWidget {
 		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(23.1, 114.1)), false, module, BusDepot::RIGHT_OUTPUT, module ? &module->color_theme : NULL));
 		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(7.45, 103.85)), false, module, BusDepot::BUS_OUTPUT, module ? &module->color_theme : NULL));
 
-		// create vu lights
-		for (int i = 0; i < 11; i++) {
-			float spacing = i * 4.25;
-			float top = 49.5;
-			if (i < 1 ) {
-				addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(4.95, top + spacing)), module, BusDepot::LEFT_LIGHTS + i));
-				addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(25.6, top + spacing)), module, BusDepot::RIGHT_LIGHTS + i));
-			} else {
-				if (i < 2) {
-					addChild(createLightCentered<MediumLight<YellowLight>>(mm2px(Vec(4.95, top + spacing)), module, BusDepot::LEFT_LIGHTS + i));
-					addChild(createLightCentered<MediumLight<YellowLight>>(mm2px(Vec(25.6, top + spacing)), module, BusDepot::RIGHT_LIGHTS + i));
-				} else {
-					addChild(createLightCentered<MediumLight<GreenLight>>(mm2px(Vec(4.95, top + spacing)), module, BusDepot::LEFT_LIGHTS + i));
-					addChild(createLightCentered<MediumLight<GreenLight>>(mm2px(Vec(25.6, top + spacing)), module, BusDepot::RIGHT_LIGHTS + i));
-				}
-			}
-		}
+		// create vu meters
+		addChild(createGtgVuMeter(Vec(4.95, 49.5), 4.25, 1.588, module ? &module->vu_levels[0] : NULL, module ? &module->vu_peaks[0] : NULL));
+		addChild(createGtgVuMeter(Vec(25.6, 49.5), 4.25, 1.588, module ? &module->vu_levels[1] : NULL, module ? &module->vu_peaks[1] : NULL));
 	}
 
 	// build the menu
@@ -574,6 +580,7 @@ struct BusDepotWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -583,6 +590,7 @@ struct BusDepotWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -638,6 +646,30 @@ struct BusDepotWidget : ModuleWidget {
 		auditionModesItem->module = module;
 		menu->addChild(auditionModesItem);
 
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		StationsItem *receiveStationsItem = createMenuItem<StationsItem>("Receive from Station");
+		receiveStationsItem->rightText = RIGHT_ARROW;
+		receiveStationsItem->station = &(module->receive_station);
+		receiveStationsItem->other_station = &(module->station_publisher.station);
+		receiveStationsItem->other_text = "Published here";
+		menu->addChild(receiveStationsItem);
+
+		AuditionGroupsItem *auditionGroupsItem = createMenuItem<AuditionGroupsItem>("Audition Group");
+		auditionGroupsItem->rightText = RIGHT_ARROW;
+		auditionGroupsItem->audition = &(module->audition);
+		menu->addChild(auditionGroupsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		stationsItem->other_station = &(module->receive_station);
+		stationsItem->other_text = "Received here";
+		menu->addChild(stationsItem);
+
 #ifndef USING_CARDINAL_NOT_RACK
 		menu->addChild(new MenuEntry);
 
@@ -648,19 +680,19 @@ struct BusDepotWidget : ModuleWidget {
 #endif
 	}
 
-	// display the panel based on the theme
+	// display the panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((BusDepot*)module)->color_theme) == 0);
-			night_panel->visible = ((((BusDepot*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "BusDepot", settings::darkMode);
+#endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			BusDepot *themed_module = (BusDepot*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "BusDepot", themed_module->color_theme == 1);
 #endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
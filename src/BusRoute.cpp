@@ -1,12 +1,35 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
 #include "gtgDSP.hpp"
+#include "gtgStations.hpp"
+
+
+// note values for delays at the manual menu tempo, in quarter note beats
+const int DELAY_NOTE_COUNT = 14;
+const char *delay_note_names[DELAY_NOTE_COUNT] = {"1/32", "1/16T", "1/16", "1/8T", "1/16D", "1/8", "1/4T", "1/8D", "1/4", "1/2T", "1/4D", "1/2", "1/2D", "1/1"};
+const float delay_note_beats[DELAY_NOTE_COUNT] = {0.125f, 1.f / 6.f, 0.25f, 1.f / 3.f, 0.375f, 0.5f, 2.f / 3.f, 0.75f, 1.f, 4.f / 3.f, 1.5f, 2.f, 3.f, 4.f};
+
+const float max_delay_seconds = 2.f;
+
+// shows note names and the manual tempo on the delay knobs in tempo mode
+struct DelayQuantity : ParamQuantity {
+	int *delay_units = NULL;
+	float *delay_bpm = NULL;
+	std::string getDisplayValueString() override {
+		if (delay_units && *delay_units == 2) {
+			int note = math::clamp((int)getValue(), 0, DELAY_NOTE_COUNT - 1);
+			return string::f("%s at %.1f BPM", delay_note_names[note], *delay_bpm);
+		}
+		return ParamQuantity::getDisplayValueString();
+	}
+};
 
 
 struct BusRoute : Module {
 	enum ParamIds {
 		ENUMS(DELAY_PARAMS, 3),
 		ENUMS(ONAU_PARAMS, 3),
+		ENUMS(RETURN_PARAMS, 3),
 		NUM_PARAMS
 	};
 	enum InputIds {
@@ -31,22 +54,40 @@ struct BusRoute : Module {
 	AutoFader route_fader[3];
 
 	const int fade_speed = 26;
-	float delay_buf[1000][6] = {};
-	int delay_i = 0;
+	DelayRing delay_rings[6];
 	int delay_knobs[3] = {0, 0, 0};
+	int delay_displays[3] = {0, 0, 0};   // delay knobs, or milliseconds of the note in tempo mode
+	float delay_times[3] = {0.f, 0.f, 0.f};   // slewed delays in samples
+	int delay_units = 0;   // 0 for samples, 1 for milliseconds, 2 for note values
+	float delay_bpm = 120.f;   // set in the menu, note delays do not follow a clock
+	int return_modes[3] = {0, 0, 0};   // 0 for send and return, 1 for insert with wet and dry
+	VectorSlewer dry_slewers[2];   // dry and return gains for the six channels, in two blocks
+	VectorSlewer return_slewers[2];
+	const int return_speed = 20;
 	bool bus_audition[3] = {false, false, false};
 	bool auditioning = false;
+	int bus_rig = 0;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
 	BusRoute() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
-		configParam(DELAY_PARAMS + 0, 0, 999, 0, "Sample delay on blue bus");
-		configParam(DELAY_PARAMS + 1, 0, 999, 0, "Sample delay on orange bus");
-		configParam(DELAY_PARAMS + 2, 0, 999, 0, "Sample delay on red bus");
+		configParam<DelayQuantity>(DELAY_PARAMS + 0, 0, 999, 0, "Sample delay on blue bus");
+		configParam<DelayQuantity>(DELAY_PARAMS + 1, 0, 999, 0, "Sample delay on orange bus");
+		configParam<DelayQuantity>(DELAY_PARAMS + 2, 0, 999, 0, "Sample delay on red bus");
+		for (int sb = 0; sb < 3; sb++) {
+			DelayQuantity *delay_quantity = (DelayQuantity*)paramQuantities[DELAY_PARAMS + sb];
+			delay_quantity->delay_units = &delay_units;
+			delay_quantity->delay_bpm = &delay_bpm;
+		}
+		setDelayUnits(0);
 		configParam(ONAU_PARAMS + 0, 0.f, 1.f, 0.f, "Blue bus on (hold to audition)");
 		configParam(ONAU_PARAMS + 1, 0.f, 1.f, 0.f, "Orange bus on (hold to audition)");
 		configParam(ONAU_PARAMS + 2, 0.f, 1.f, 0.f, "Red bus on (hold to audition)");
+		configParam(RETURN_PARAMS + 0, 0.f, 1.f, 1.f, "Blue return level", "%", 0.f, 100.f);
+		configParam(RETURN_PARAMS + 1, 0.f, 1.f, 1.f, "Orange return level", "%", 0.f, 100.f);
+		configParam(RETURN_PARAMS + 2, 0.f, 1.f, 1.f, "Red return level", "%", 0.f, 100.f);
 		configInput(RETURN_INPUTS + 0, "Blue return left");
 		configInput(RETURN_INPUTS + 1, "Blue return right");
 		configInput(RETURN_INPUTS + 2, "Orange return left");
@@ -67,10 +108,47 @@ struct BusRoute : Module {
 		for (int i = 0; i < 3; i++) {
 			route_fader[i].setSpeed(fade_speed);
 		}
+		for (int i = 0; i < 2; i++) {
+			dry_slewers[i].setSlewSpeed(return_speed);
+			return_slewers[i].setSlewSpeed(return_speed);
+			dry_slewers[i].value = 1.f;
+			return_slewers[i].value = 1.f;
+		}
 		gtg_default_theme = loadGtgPluginDefault("default_theme", 0);
 		color_theme = gtg_default_theme;
 	}
 
+
+	// switch delay knobs between samples (up to 999), milliseconds (up to 2 seconds) and note values
+	void setDelayUnits(int units) {
+		delay_units = units;
+		std::string bus_names[3] = {"blue", "orange", "red"};
+		for (int sb = 0; sb < 3; sb++) {
+			ParamQuantity *delay_quantity = paramQuantities[DELAY_PARAMS + sb];
+			if (delay_units == 1) {
+				delay_quantity->maxValue = 2000.f;
+				delay_quantity->name = "Millisecond delay on " + bus_names[sb] + " bus";
+				delay_quantity->unit = " ms";
+			} else if (delay_units == 2) {
+				delay_quantity->maxValue = DELAY_NOTE_COUNT - 1;
+				delay_quantity->name = "Note delay on " + bus_names[sb] + " bus, manual tempo";
+				delay_quantity->unit = "";
+			} else {
+				delay_quantity->maxValue = 999.f;
+				delay_quantity->name = "Sample delay on " + bus_names[sb] + " bus";
+				delay_quantity->unit = "";
+			}
+			params[DELAY_PARAMS + sb].setValue(std::fmin(params[DELAY_PARAMS + sb].getValue(), delay_quantity->maxValue));
+		}
+	}
+
+	// the return knob sets the return level, or the wet amount in insert mode
+	void setReturnMode(int sb, int mode) {
+		return_modes[sb] = mode;
+		std::string bus_names[3] = {"Blue", "Orange", "Red"};
+		paramQuantities[RETURN_PARAMS + sb]->name = bus_names[sb] + ((mode == 1) ? " insert wet" : " return level");
+	}
+
 	void process(const ProcessArgs &args) override {
 
 		// get button presses
@@ -112,10 +190,6 @@ struct BusRoute : Module {
 		// set send or audtion button lights
 		if (light_divider.process()) {
 
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
-
 			if (auditioning) {
 				for (int i = 0; i < 3; i++) {
 					if (bus_audition[i]) {
@@ -165,61 +239,117 @@ struct BusRoute : Module {
 
 		}
 
-		// record bus inputs into delay buffer
-		for (int c = 0; c < 6; c++) {
-			delay_buf[delay_i][c] = inputs[BUS_INPUT].getPolyVoltage(c);
-		}
+		// get the selected rig, the other rig passes through
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		float bus_in[6];
+		bus_frame.getRig(bus_rig, bus_in);
 
-		// get outputs and sends
-		float bus_out[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
-		float mix_out[2] = {0.f, 0.f};
+		// get sends, then dry buses and returns with their gains
+		alignas(16) float bus_dry[8] = {};
+		alignas(16) float bus_returns[8] = {};
+		alignas(16) float dry_gains[8] = {};
+		alignas(16) float return_gains[8] = {};
+
+		// delay times glide to new settings instead of jumping, about 50 ms
+		float delay_slew = std::fmin(1.f, 20.f * args.sampleTime);
 
 		for (int sb = 0; sb < 3; sb++) {   // sb = stereo bus
 
 			// get delay knob settings, used here and in display values
 			delay_knobs[sb] = params[DELAY_PARAMS + sb].getValue();
 
-			// set channel's delay
-			int delay = delay_i - delay_knobs[sb];
-			if (delay < 0) delay = 1000 + delay;   // adjust delay when buffer rolls
+			// set channel's delay in samples, milliseconds and note values follow the sample rate
+			float delay_target = delay_knobs[sb];
+			if (delay_units == 1) {
+				delay_target = delay_knobs[sb] * args.sampleRate * 0.001f;
+			} else if (delay_units == 2) {
+				int note = math::clamp(delay_knobs[sb], 0, DELAY_NOTE_COUNT - 1);
+				delay_target = delay_note_beats[note] * 60.f / delay_bpm * args.sampleRate;
+			}
+			delay_target = std::fmin(delay_target, max_delay_seconds * args.sampleRate);
+			delay_displays[sb] = (delay_units == 2) ? (int)std::round(delay_target * args.sampleTime * 1000.f) : delay_knobs[sb];
 
-			// set send outputs from delay buffer
-			int chan = sb * 2;
+			if (delay_times[sb] != delay_target) {
+				delay_times[sb] += (delay_target - delay_times[sb]) * delay_slew;
+				if (std::fabs(delay_target - delay_times[sb]) < 0.001f) delay_times[sb] = delay_target;
+			}
 
-			// buses to send outputs or directly to bus out if sends are not connected
-			if (outputs[SEND_OUTPUTS + chan].isConnected() || outputs[SEND_OUTPUTS + chan + 1].isConnected()) {
-				outputs[SEND_OUTPUTS + chan].setVoltage(delay_buf[delay][chan] * route_fader[sb].getFade());   // left
-				outputs[SEND_OUTPUTS + chan + 1].setVoltage(delay_buf[delay][chan + 1] * route_fader[sb].getFade());   // right
+			// rings are only written while a bus is delayed, a delay turned up from zero starts from an empty ring
+			int chan = sb * 2;
+			float bus_delayed[2] = {bus_in[chan], bus_in[chan + 1]};
+			if (delay_target > 0.f || delay_times[sb] > 0.f) {
+				long longest = (long)std::fmax(delay_target, delay_times[sb]) + 1;
+				for (int c = 0; c < 2; c++) {
+					if (delay_rings[chan + c].prepare(longest)) {
+						delay_rings[chan + c].write(bus_in[chan + c]);
+						bus_delayed[c] = delay_rings[chan + c].readFrac(delay_times[sb]);
+					} else {
+						bus_delayed[c] = 0.f;   // nothing recorded until the first ring is offered
+					}
+				}
 			} else {
-
-				bus_out[chan] = delay_buf[delay][chan] * route_fader[sb].getFade();
-				bus_out[chan + 1] = delay_buf[delay][chan + 1] * route_fader[sb].getFade();
+				delay_rings[chan].release();
+				delay_rings[chan + 1].release();
 			}
 
-			// get all returns, even if sends are not connected or off, allows hearing the tail of a return
-			bus_out[chan] += inputs[RETURN_INPUTS + chan].getVoltage();
-			bus_out[chan + 1] += inputs[RETURN_INPUTS + chan + 1].getVoltage();
+			// buses to send outputs, inserts keep the dry bus, or directly to bus out if sends are not connected
+			bool sending = outputs[SEND_OUTPUTS + chan].isConnected() || outputs[SEND_OUTPUTS + chan + 1].isConnected();
+			float return_level = params[RETURN_PARAMS + sb].getValue();
+			for (int c = 0; c < 2; c++) {
+				float bus_faded = bus_delayed[c] * route_fader[sb].getFade();
+				if (sending) outputs[SEND_OUTPUTS + chan + c].setVoltage(bus_faded);
+				bus_dry[chan + c] = bus_faded;
+
+				// get all returns, even if sends are not connected or off, allows hearing the tail of a return
+				bus_returns[chan + c] = inputs[RETURN_INPUTS + chan + c].getVoltage();
 
-			// sum mix out
-			mix_out[0] += bus_out[chan];
-			mix_out[1] += bus_out[chan + 1];
+				if (return_modes[sb] == 1) {
+					dry_gains[chan + c] = 1.f - return_level;
+				} else {
+					dry_gains[chan + c] = sending ? 0.f : 1.f;
+				}
+				return_gains[chan + c] = return_level;
+			}
 		}
 
-		// final bus out
-		for (int c = 0; c < 6; c++) {
-			outputs[BUS_OUTPUT].setVoltage(bus_out[c], c);
+		// mix dry buses and returns with smoothed gains
+		alignas(16) float bus_out[8];
+		for (int i = 0; i < 2; i++) {
+			simd::float_4 dry_gain = dry_slewers[i].slew(simd::float_4::load(&dry_gains[i * 4]));
+			simd::float_4 return_gain = return_slewers[i].slew(simd::float_4::load(&return_gains[i * 4]));
+			simd::float_4 out = simd::float_4::load(&bus_dry[i * 4]) * dry_gain + simd::float_4::load(&bus_returns[i * 4]) * return_gain;
+			out.store(&bus_out[i * 4]);
 		}
 
-		// set output to 3 stereo buses
-		outputs[BUS_OUTPUT].setChannels(6);
+		// sum mix out
+		float mix_out[2] = {bus_out[0] + bus_out[2] + bus_out[4], bus_out[1] + bus_out[3] + bus_out[5]};
+
+		// final bus out on the selected rig
+		bus_frame.setRig(bus_rig, bus_out);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
 
 		// final mix out
 		outputs[MIX_L_OUTPUT].setVoltage(mix_out[0]);
 		outputs[MIX_R_OUTPUT].setVoltage(mix_out[1]);
+	}
+
+	// pass the bus chain through when bypassed, sends are silent and mix outs get the unity mix of the selected rig
+	void processBypass(const ProcessArgs &args) override {
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.store(outputs[BUS_OUTPUT], busChannels(inputs[BUS_INPUT], 0));
+
+		for (int c = 0; c < 6; c++) {
+			outputs[SEND_OUTPUTS + c].setVoltage(0.f);
+		}
 
-		// roll buffer index
-		delay_i++;
-		if (delay_i >= 1000) delay_i = 0;
+		float bus_in[6];
+		bus_frame.getRig(bus_rig, bus_in);
+		outputs[MIX_L_OUTPUT].setVoltage(bus_in[0] + bus_in[2] + bus_in[4]);
+		outputs[MIX_R_OUTPUT].setVoltage(bus_in[1] + bus_in[3] + bus_in[5]);
 	}
 
 	// save on color theme
@@ -235,6 +365,16 @@ struct BusRoute : Module {
 		json_object_set_new(rootJ, "temped1", json_integer(route_fader[0].temped));
 		json_object_set_new(rootJ, "temped2", json_integer(route_fader[1].temped));
 		json_object_set_new(rootJ, "temped3", json_integer(route_fader[2].temped));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
+		json_object_set_new(rootJ, "delay_units", json_integer(delay_units));
+		json_object_set_new(rootJ, "delay_bpm", json_real(delay_bpm));
+		json_object_set_new(rootJ, "delay1", json_integer(params[DELAY_PARAMS + 0].getValue()));
+		json_object_set_new(rootJ, "delay2", json_integer(params[DELAY_PARAMS + 1].getValue()));
+		json_object_set_new(rootJ, "delay3", json_integer(params[DELAY_PARAMS + 2].getValue()));
+		json_object_set_new(rootJ, "return_mode1", json_integer(return_modes[0]));
+		json_object_set_new(rootJ, "return_mode2", json_integer(return_modes[1]));
+		json_object_set_new(rootJ, "return_mode3", json_integer(return_modes[2]));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
 		return rootJ;
@@ -266,21 +406,51 @@ struct BusRoute : Module {
 		json_t *temped3j = json_object_get(rootJ, "temped3");
 		if (temped3j) route_fader[2].temped = json_integer_value(temped3j);
 
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
+
+		json_t *delay_unitsJ = json_object_get(rootJ, "delay_units");
+		if (delay_unitsJ) setDelayUnits(json_integer_value(delay_unitsJ));
+
+		// params load before the delay units set their range, so delays over 999 ms are restored here
+		json_t *delay1J = json_object_get(rootJ, "delay1");
+		if (delay1J) params[DELAY_PARAMS + 0].setValue(std::fmin(json_integer_value(delay1J), paramQuantities[DELAY_PARAMS + 0]->maxValue));
+		json_t *delay2J = json_object_get(rootJ, "delay2");
+		if (delay2J) params[DELAY_PARAMS + 1].setValue(std::fmin(json_integer_value(delay2J), paramQuantities[DELAY_PARAMS + 1]->maxValue));
+		json_t *delay3J = json_object_get(rootJ, "delay3");
+		if (delay3J) params[DELAY_PARAMS + 2].setValue(std::fmin(json_integer_value(delay3J), paramQuantities[DELAY_PARAMS + 2]->maxValue));
+		json_t *delay_bpmJ = json_object_get(rootJ, "delay_bpm");
+		if (delay_bpmJ) delay_bpm = json_number_value(delay_bpmJ);
+
+		json_t *return_mode1J = json_object_get(rootJ, "return_mode1");
+		if (return_mode1J) setReturnMode(0, json_integer_value(return_mode1J));
+		json_t *return_mode2J = json_object_get(rootJ, "return_mode2");
+		if (return_mode2J) setReturnMode(1, json_integer_value(return_mode2J));
+		json_t *return_mode3J = json_object_get(rootJ, "return_mode3");
+		if (return_mode3J) setReturnMode(2, json_integer_value(return_mode3J));
+
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
 		} else {
 			if (onau_1J) use_default_theme = false;   // do not change existing patches
 		}
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
 	}
 
-	// reset fader speed
+	// reset fader and return speeds
 	void onSampleRateChange() override {
 		for (int i = 0; i < 3; i++) {
 			route_fader[i].setSpeed(fade_speed);
 		}
+		for (int i = 0; i < 2; i++) {
+			dry_slewers[i].setSlewSpeed(return_speed);
+			return_slewers[i].setSlewSpeed(return_speed);
+		}
 	}
 
 	// reset on audition states when initialized
@@ -289,65 +459,78 @@ struct BusRoute : Module {
 		for (int i = 0; i < 3; i++) {
 			route_fader[i].on = true;
 			bus_audition[i] = false;
+			setReturnMode(i, 0);
 		}
+		bus_rig = 0;
+		setDelayUnits(0);
+		delay_bpm = 120.f;
+		station_publisher.station = -1;
+	}
+};
+
+
+// tempo for note value delays
+struct DelayTempo : Quantity {
+	float *srcBpm = NULL;
+
+	DelayTempo(float *_srcBpm) {
+		srcBpm = _srcBpm;
+	}
+	void setValue(float value) override {
+		*srcBpm = math::clamp(value, getMinValue(), getMaxValue());
+	}
+	float getValue() override {
+		return *srcBpm;
+	}
+	float getMinValue() override {return 30.0f;}
+	float getMaxValue() override {return 300.0f;}
+	float getDefaultValue() override {return 120.0f;}
+	std::string getDisplayValueString() override {
+		return string::f("%.1f", getValue());
+	}
+	std::string getLabel() override {return "Manual tempo";}
+	std::string getUnit() override {return " BPM";}
+};
+
+struct DelayTempoSliderItem : ui::Slider {
+	DelayTempoSliderItem(float *bpm) {
+		quantity = new DelayTempo(bpm);
+	}
+	~DelayTempoSliderItem() {
+		delete quantity;
 	}
 };
 
 
 // delay display widget
-struct DelayDisplayWidget : TransparentWidget {
+struct DelayDisplayWidget : GtgNumberDisplay {
 	BusRoute *module;
-	std::string fontPath="res/fonts/DSEG7-Classic-MINI/DSEG7ClassicMini-Bold.ttf";
 	int delay_knob = 0;
 
 	DelayDisplayWidget() {
 		box.size = mm2px(Vec(6.519, 4.0));
+		number_text->text_pos = mm2px(Vec(6.05, 3.1));
 	}
 
-	void draw(const DrawArgs &args) override {
-		int value = module ? module->delay_knobs[delay_knob] : 0;
-		std::shared_ptr<Font> font = APP->window->loadFont(asset::plugin(pluginInstance, fontPath));
-		std::string text = string::f("%03d", value);
-
-		// background
-		NVGcolor backgroundColor = nvgRGB(26, 26, 26);
-		nvgBeginPath(args.vg);
-		nvgRoundedRect(args.vg, 0.0, 0.0, box.size.x, box.size.y, 1.5);
-		nvgFillColor(args.vg, backgroundColor);
-		nvgFill(args.vg);
-
-		// display text text
-		if (font) {
-			nvgFontSize(args.vg, 6);
-			nvgFontFaceId(args.vg, font->handle);
-			nvgTextLetterSpacing(args.vg, 0.5);
-			nvgTextAlign(args.vg, NVG_ALIGN_RIGHT);
-			Vec textPos = mm2px(Vec(6.05, 3.1));
-			NVGcolor textColor = nvgRGB(0x90, 0xc7, 0x3e);
-			nvgFillColor(args.vg, textColor);
-			nvgText(args.vg, textPos.x, textPos.y, text.c_str(), NULL);
-		}
+	float getValue() override {
+		return module ? module->delay_displays[delay_knob] : 0;
+	}
+
+	std::string formatValue(float value) override {
+		int delay = value;
+		if (delay > 999) return string::f("%.2f", delay * 0.001f);   // show seconds when milliseconds need four digits
+		return string::f("%03d", delay);
 	}
 };
 
 
 struct BusRouteWidget : ModuleWidget {
-	SvgPanel* night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	BusRouteWidget(BusRoute *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/BusRoute.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/BusRoute_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("BusRoute", 0));
 
 		DelayDisplayWidget *blueDisplay = createWidgetCentered<DelayDisplayWidget>(mm2px(Vec(15.25, 23.64)));
 		blueDisplay->module = module;
@@ -398,11 +581,70 @@ struct BusRouteWidget : ModuleWidget {
 		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(23.49, 114.107)), false, module, BusRoute::MIX_R_OUTPUT, module ? &module->color_theme : NULL));
 	}
 
-#ifndef USING_CARDINAL_NOT_RACK
 	// build the menu
 	void appendContextMenu(Menu* menu) override {
 		BusRoute* module = dynamic_cast<BusRoute*>(this->module);
 
+		struct DelayUnitItem : MenuItem {
+			BusRoute *module;
+			int delay_units;
+			void onAction(const event::Action &e) override {
+				module->setDelayUnits(delay_units);
+			}
+		};
+
+		struct DelayUnitsItem : MenuItem {
+			BusRoute *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string unit_titles[3] = {"Samples up to 999 (default)", "Milliseconds up to 2 seconds", "Note values at manual tempo"};
+				for (int i = 0; i < 3; i++) {
+					DelayUnitItem *delay_unit_item = new DelayUnitItem;
+					delay_unit_item->text = unit_titles[i];
+					delay_unit_item->rightText = CHECKMARK(module->delay_units == i);
+					delay_unit_item->module = module;
+					delay_unit_item->delay_units = i;
+					menu->addChild(delay_unit_item);
+				}
+				DelayTempoSliderItem *delayTempoSliderItem = new DelayTempoSliderItem(&(module->delay_bpm));
+				delayTempoSliderItem->box.size.x = 190.f;
+				menu->addChild(delayTempoSliderItem);
+				return menu;
+			}
+		};
+
+		struct ReturnModeItem : MenuItem {
+			BusRoute *module;
+			int sb;
+			void onAction(const event::Action &e) override {
+				module->setReturnMode(sb, !module->return_modes[sb]);
+			}
+		};
+
+		struct ReturnsItem : MenuItem {
+			BusRoute *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				for (int i = 0; i < 3; i++) {
+					ui::Slider *return_slider = new ui::Slider;
+					return_slider->quantity = module->paramQuantities[BusRoute::RETURN_PARAMS + i];
+					return_slider->box.size.x = 190.f;
+					menu->addChild(return_slider);
+				}
+				menu->addChild(new MenuEntry);
+				std::string mode_titles[3] = {"Blue insert with wet and dry", "Orange insert with wet and dry", "Red insert with wet and dry"};
+				for (int i = 0; i < 3; i++) {
+					ReturnModeItem *return_mode_item = new ReturnModeItem;
+					return_mode_item->text = mode_titles[i];
+					return_mode_item->rightText = CHECKMARK(module->return_modes[i] == 1);
+					return_mode_item->module = module;
+					return_mode_item->sb = i;
+					menu->addChild(return_mode_item);
+				}
+				return menu;
+			}
+		};
+
 		struct ThemeItem : MenuItem {
 			BusRoute* module;
 			int theme;
@@ -414,6 +656,7 @@ struct BusRouteWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -423,6 +666,7 @@ struct BusRouteWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -462,26 +706,49 @@ struct BusRouteWidget : ModuleWidget {
 
 		menu->addChild(new MenuEntry);
 
+		DelayUnitsItem *delayUnitsItem = createMenuItem<DelayUnitsItem>("Delay Units");
+		delayUnitsItem->rightText = RIGHT_ARROW;
+		delayUnitsItem->module = module;
+		menu->addChild(delayUnitsItem);
+
+		ReturnsItem *returnsItem = createMenuItem<ReturnsItem>("Returns");
+		returnsItem->rightText = RIGHT_ARROW;
+		returnsItem->module = module;
+		menu->addChild(returnsItem);
+
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
+#ifndef USING_CARDINAL_NOT_RACK
+		menu->addChild(new MenuEntry);
+
 		ThemesItem *themesItem = createMenuItem<ThemesItem>("Panel Themes");
 		themesItem->rightText = RIGHT_ARROW;
 		themesItem->module = module;
 		menu->addChild(themesItem);
-	}
 #endif
+	}
 
-	// display the panel based on the theme
+	// display the panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((BusRoute*)module)->color_theme) == 0);
-			night_panel->visible = ((((BusRoute*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "BusRoute", settings::darkMode);
 #endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			BusRoute *themed_module = (BusRoute*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "BusRoute", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
@@ -0,0 +1,577 @@
+#include "plugin.hpp"
+#include "gtgComponents.hpp"
+#include "gtgDSP.hpp"
+#include "gtgAudition.hpp"
+#include "gtgStations.hpp"
+
+
+// eight stereo mixer strips in one module
+// strip levels, pans and fades are kept four strips at a time in float_4 blocks
+
+const int CONSOLE_STRIPS = 8;
+const int CONSOLE_BLOCKS = CONSOLE_STRIPS / 4;
+
+struct Console : Module {
+	enum ParamIds {
+		ENUMS(ON_PARAMS, 8),
+		ENUMS(PAN_PARAMS, 8),
+		ENUMS(BLUE_PARAMS, 8),
+		ENUMS(ORANGE_PARAMS, 8),
+		ENUMS(RED_PARAMS, 8),
+		NUM_PARAMS
+	};
+	enum InputIds {
+		ENUMS(LMP_INPUTS, 8),
+		ENUMS(R_INPUTS, 8),
+		ENUMS(ON_CV_INPUTS, 8),
+		ENUMS(LEVEL_CV_INPUTS, 8),
+		BUS_INPUT,
+		NUM_INPUTS
+	};
+	enum OutputIds {
+		BUS_OUTPUT,
+		NUM_OUTPUTS
+	};
+	enum LightIds {
+		ENUMS(ON_LIGHTS, 16),
+		NUM_LIGHTS
+	};
+
+	LongPressButton on_buttons[8];
+	dsp::SchmittTrigger on_cv_triggers[8];
+	dsp::ClockDivider pan_divider;
+	dsp::ClockDivider light_divider;
+	AutoFader strip_faders[8];
+
+	simd::float_4 pan_levels[2][CONSOLE_BLOCKS] = {};   // left and right pan levels for each block of strips
+	simd::float_4 red_levels[CONSOLE_BLOCKS] = {};   // smoothed red levels
+	float level_delta = 0.0005f;
+
+	const int bypass_speed = 26;
+	const int level_speed = 26;   // for level cv filter
+	float fade_in = 26.f;
+	float fade_out = 26.f;
+	bool auto_override[8] = {};
+	bool auditioned[8] = {};
+	AuditionFollower audition{mixer_auditions};
+	bool post_fades = true;
+	int bus_rig = 0;
+	StationPublisher station_publisher;
+	int color_theme = 0;
+	bool use_default_theme = true;
+
+	Console() {
+		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			std::string strip = string::f("Strip %d ", s + 1);
+			configParam(ON_PARAMS + s, 0.f, 1.f, 0.f, strip + "input on");
+			configParam(PAN_PARAMS + s, -1.f, 1.f, 0.f, strip + "pan");
+			configParam(BLUE_PARAMS + s, 0.f, 1.f, 0.f, strip + "post red level send to blue stereo bus");
+			configParam(ORANGE_PARAMS + s, 0.f, 1.f, 0.f, strip + "post red level send to orange stereo bus");
+			configParam(RED_PARAMS + s, 0.f, 1.f, 1.f, strip + "level to red stereo bus");
+			configInput(LMP_INPUTS + s, strip + "left, mono, or poly");
+			configInput(R_INPUTS + s, strip + "right");
+			configInput(ON_CV_INPUTS + s, strip + "on CV");
+			configInput(LEVEL_CV_INPUTS + s, strip + "red level CV");
+			strip_faders[s].setSpeed(fade_in);
+		}
+		configInput(BUS_INPUT, "Bus chain");
+		configOutput(BUS_OUTPUT, "Bus chain");
+		pan_divider.setDivision(3);
+		light_divider.setDivision(512);
+		setLevelSpeed();
+		gtg_default_theme = loadGtgPluginDefault("default_theme", 0);
+		color_theme = gtg_default_theme;
+	}
+
+	void setLevelSpeed() {
+		float sampleRate = APP->engine->getSampleRate();
+		level_delta = 1.f / (sampleRate * 0.001f * (float)level_speed);   // milliseconds from 0 to 1
+	}
+
+	void process(const ProcessArgs &args) override {
+
+		// audition changes apply on the same frame in every mixer of the audition group
+		bool audition_changed = audition.process(args.frame);
+
+		// on off buttons
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			switch (on_buttons[s].step(params[ON_PARAMS + s])) {
+			default:
+			case LongPressButton::NO_PRESS:
+				break;
+			case LongPressButton::SHORT_PRESS:
+				if (audition.active) {
+					audition.set(false, args.frame);   // single click turns off auditions
+				} else {
+					if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL) {   // bypass fades with ctrl click
+						auto_override[s] = true;
+						strip_faders[s].setSpeed(bypass_speed);
+
+						// bypass the fade even if the fade is already underway
+						if (strip_faders[s].on) {
+							strip_faders[s].on = (strip_faders[s].getFade() != strip_faders[s].getGain());
+						} else {
+							strip_faders[s].on = (strip_faders[s].getFade() == 0.f);
+						}
+
+					} else {   // normal single click
+						auto_override[s] = false;   // do not override automation
+						strip_faders[s].on = !strip_faders[s].on;
+						if (strip_faders[s].on) {
+							strip_faders[s].setSpeed(int(fade_in));
+						} else {
+							strip_faders[s].setSpeed(int(fade_out));
+						}
+					}
+				}
+				break;
+			case LongPressButton::LONG_PRESS:   // long press to audition
+
+				audition.set(true, args.frame);   // all mixers to audition mode
+
+				if (auditioned[s]) {
+					auditioned[s] = false;
+					if (strip_faders[s].temped) {
+						strip_faders[s].temped = false;
+						strip_faders[s].on = false;
+					}
+				} else {
+					auditioned[s] = true;
+					if (!strip_faders[s].on) {
+						strip_faders[s].temped = !strip_faders[s].temped;   // remember if auditioned strip is off
+					}
+				}
+				break;
+			}
+
+			// process cv trigger
+			if (on_cv_triggers[s].process(inputs[ON_CV_INPUTS + s].getVoltage())) {
+				if (!audition.active) {
+					auto_override[s] = false;   // do not override automation
+					strip_faders[s].on = !strip_faders[s].on;
+				}
+			}
+
+			strip_faders[s].process();
+		}
+
+		// apply audition changes on the same frame as other mixers
+		if (audition_changed) {
+			for (int s = 0; s < CONSOLE_STRIPS; s++) {
+				if (audition.active) {   // all mixers are in audition state
+
+					// bypass all fade automation
+					auto_override[s] = true;
+					strip_faders[s].setSpeed(bypass_speed);
+
+					if (auditioned[s]) {   // this strip is being auditioned
+						strip_faders[s].on = true;
+					} else {   // mute the strips
+						if (strip_faders[s].on) {
+							strip_faders[s].temped = true;   // remember this strip was on
+						}
+						strip_faders[s].on = false;
+					}
+				} else {   // stop auditions
+
+					// return to states before auditions
+					if (strip_faders[s].temped) {
+						strip_faders[s].temped = false;
+						auto_override[s] = true;
+						strip_faders[s].setSpeed(bypass_speed);
+						if (auditioned[s]) {
+							strip_faders[s].on = false;
+						} else {
+							strip_faders[s].on = true;
+						}
+					}
+
+					// turn off auditions
+					auditioned[s] = false;
+				}
+			}
+		}
+
+		// process fade states and lights
+		if (light_divider.process()) {
+
+			for (int s = 0; s < CONSOLE_STRIPS; s++) {
+				// process fade speed changes if dragging slider
+				if (!auto_override[s]) {
+					if (strip_faders[s].on) {
+						if (int(fade_in) != strip_faders[s].last_speed) {
+							strip_faders[s].setSpeed(int(fade_in));
+						}
+					} else {
+						if (int(fade_out) != strip_faders[s].last_speed) {
+							strip_faders[s].setSpeed(int(fade_out));
+						}
+					}
+				}
+
+				// set on lights
+				if (strip_faders[s].getFade() == strip_faders[s].getGain()) {
+					if (audition.active) {
+						lights[ON_LIGHTS + (s * 2)].value = 1.f;   // yellow when auditioned
+						lights[ON_LIGHTS + (s * 2) + 1].value = 1.f;
+					} else {
+						lights[ON_LIGHTS + (s * 2)].value = 1.f;   // green when on
+						lights[ON_LIGHTS + (s * 2) + 1].value = 0.f;
+					}
+				} else {
+					if (strip_faders[s].temped) {
+						lights[ON_LIGHTS + (s * 2)].value = 0.f;   // red when muted by audition
+						lights[ON_LIGHTS + (s * 2) + 1].value = 1.f;
+					} else {
+						lights[ON_LIGHTS + (s * 2)].value = strip_faders[s].getFade();   // yellow dimmer when fading
+						lights[ON_LIGHTS + (s * 2) + 1].value = strip_faders[s].getFade() * 0.5f;
+					}
+				}
+			}
+		}
+
+		// gather strip inputs, knobs and fades into blocks of four strips
+		alignas(16) float strip_values[7][CONSOLE_STRIPS];   // left, right, pan, blue, orange, red, fade
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			if (inputs[R_INPUTS + s].isConnected()) {   // get a channel from each cable input
+				strip_values[0][s] = inputs[LMP_INPUTS + s].getVoltage();
+				strip_values[1][s] = inputs[R_INPUTS + s].getVoltage();
+			} else {   // split mono or sum of polyphonic cable on LMP
+				strip_values[0][s] = inputs[LMP_INPUTS + s].getVoltageSum();
+				strip_values[1][s] = strip_values[0][s];
+			}
+			strip_values[2][s] = params[PAN_PARAMS + s].getValue();
+			strip_values[3][s] = params[BLUE_PARAMS + s].getValue();
+			strip_values[4][s] = params[ORANGE_PARAMS + s].getValue();
+			strip_values[5][s] = clamp(inputs[LEVEL_CV_INPUTS + s].getNormalVoltage(10.f) * 0.1f, 0.f, 1.f) * params[RED_PARAMS + s].getValue();
+			strip_values[6][s] = strip_faders[s].getFade();
+		}
+
+		// calculate pan levels infrequently
+		bool pan_update = pan_divider.process();
+
+		simd::float_4 stereo_sums[3][2] = {};   // blue, orange, and red sums of left and right
+		for (int b = 0; b < CONSOLE_BLOCKS; b++) {
+			int first = b * 4;
+
+			if (pan_update) {
+				constantPanLevels(simd::float_4::load(&strip_values[2][first]), pan_levels[b]);
+			}
+
+			// smooth red levels
+			simd::float_4 red_target = simd::float_4::load(&strip_values[5][first]);
+			red_levels[b] += simd::clamp(red_target - red_levels[b], -level_delta, level_delta);
+
+			// exponential fade for fade automation, equal to the fade when not fading
+			simd::float_4 fades = simd::float_4::load(&strip_values[6][first]);
+			simd::float_4 exp_fades = fades * fades * simd::sqrt(fades);
+
+			// panned and faded stereo inputs
+			simd::float_4 left = simd::float_4::load(&strip_values[0][first]) * pan_levels[0][b] * exp_fades;
+			simd::float_4 right = simd::float_4::load(&strip_values[1][first]) * pan_levels[1][b] * exp_fades;
+
+			// blue and orange are post red sends unless set to normal faders
+			simd::float_4 post_amount = post_fades ? red_levels[b] : simd::float_4(1.f);
+			simd::float_4 bus_levels[3] = {
+				simd::float_4::load(&strip_values[3][first]) * post_amount,
+				simd::float_4::load(&strip_values[4][first]) * post_amount,
+				red_levels[b]
+			};
+
+			for (int sb = 0; sb < 3; sb++) {   // sb = stereo bus
+				stereo_sums[sb][0] += left * bus_levels[sb];
+				stereo_sums[sb][1] += right * bus_levels[sb];
+			}
+		}
+
+		// sum all strips into sends for 3 stereo buses
+		float bus_sends[6];
+		for (int sb = 0; sb < 3; sb++) {
+			for (int c = 0; c < 2; c++) {
+				bus_sends[(2 * sb) + c] = stereo_sums[sb][c][0] + stereo_sums[sb][c][1] + stereo_sums[sb][c][2] + stereo_sums[sb][c][3];
+			}
+		}
+
+		// process outputs, sends go to the selected rig and the other rig passes through
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.addRig(bus_rig, bus_sends);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
+	}
+
+	// pass the bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUT], outputs[BUS_OUTPUT]);
+	}
+
+	// save on and audition states of each strip
+	json_t *dataToJson() override {
+		json_t *rootJ = json_object();
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			json_object_set_new(rootJ, string::f("input_on%d", s + 1).c_str(), json_integer(strip_faders[s].on));
+			json_object_set_new(rootJ, string::f("auditioned%d", s + 1).c_str(), json_integer(auditioned[s]));
+			json_object_set_new(rootJ, string::f("temped%d", s + 1).c_str(), json_integer(strip_faders[s].temped));
+		}
+		json_object_set_new(rootJ, "post_fades", json_integer(post_fades));
+		json_object_set_new(rootJ, "fade_in", json_real(fade_in));
+		json_object_set_new(rootJ, "fade_out", json_real(fade_out));
+		json_object_set_new(rootJ, "audition_mixer", json_integer(audition.isActive()));
+		json_object_set_new(rootJ, "audition_group", json_integer(audition.group));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
+		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
+		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t *rootJ) override {
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			json_t *input_onJ = json_object_get(rootJ, string::f("input_on%d", s + 1).c_str());
+			if (input_onJ) strip_faders[s].on = json_integer_value(input_onJ);
+			json_t *auditionedJ = json_object_get(rootJ, string::f("auditioned%d", s + 1).c_str());
+			if (auditionedJ) auditioned[s] = json_integer_value(auditionedJ);
+			json_t *tempedJ = json_object_get(rootJ, string::f("temped%d", s + 1).c_str());
+			if (tempedJ) strip_faders[s].temped = json_integer_value(tempedJ);
+		}
+		json_t *post_fadesJ = json_object_get(rootJ, "post_fades");
+		if (post_fadesJ) post_fades = json_integer_value(post_fadesJ);
+		json_t *fade_inJ = json_object_get(rootJ, "fade_in");
+		if (fade_inJ) fade_in = json_real_value(fade_inJ);
+		json_t *fade_outJ = json_object_get(rootJ, "fade_out");
+		if (fade_outJ) fade_out = json_real_value(fade_outJ);
+		json_t *audition_groupJ = json_object_get(rootJ, "audition_group");
+		if (audition_groupJ) audition.setGroup(json_integer_value(audition_groupJ));
+		json_t *audition_mixerJ = json_object_get(rootJ, "audition_mixer");
+		if (audition_mixerJ) {
+			audition.set(json_integer_value(audition_mixerJ), APP->engine->getFrame());
+		} else {
+			audition.set(false, APP->engine->getFrame());
+		}
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
+		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
+		if (use_default_themeJ) use_default_theme = json_integer_value(use_default_themeJ);
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
+		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
+		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
+	}
+
+	// reset fader speeds on sample rate change
+	void onSampleRateChange() override {
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			if (strip_faders[s].on) {
+				strip_faders[s].setSpeed(fade_in);
+			} else {
+				strip_faders[s].setSpeed(fade_out);
+			}
+		}
+		setLevelSpeed();
+	}
+
+	// initialize on states and post fades
+	void onReset() override {
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			strip_faders[s].on = true;
+			auditioned[s] = false;
+		}
+		fade_in = 26.f;
+		fade_out = 26.f;
+		post_fades = true;
+		bus_rig = 0;
+		audition.set(false, APP->engine->getFrame());
+		audition.setGroup(0);
+		station_publisher.station = -1;
+	}
+};
+
+
+struct ConsoleWidget : ModuleWidget {
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
+
+	ConsoleWidget(Console *module) {
+		setModule(module);
+		setPanel(loadGtgPanelSvg("Console", 0));
+
+		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
+		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
+		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
+		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
+
+		// one column for each strip
+		for (int s = 0; s < CONSOLE_STRIPS; s++) {
+			float x = 5.08 + (s * 10.16);
+			addParam(createThemedParamCentered<gtgBlackButton>(mm2px(Vec(x, 15.20)), module, Console::ON_PARAMS + s, module ? &module->color_theme : NULL));
+			addChild(createLightCentered<MediumLight<GreenRedLight>>(mm2px(Vec(x, 15.20)), module, Console::ON_LIGHTS + (s * 2)));
+			addInput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(x, 26.0)), true, module, Console::LMP_INPUTS + s, module ? &module->color_theme : NULL));
+			addInput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(x, 36.0)), true, module, Console::R_INPUTS + s, module ? &module->color_theme : NULL));
+			addParam(createThemedParamCentered<gtgGrayTinyKnob>(mm2px(Vec(x, 47.5)), module, Console::PAN_PARAMS + s, module ? &module->color_theme : NULL));
+			addParam(createThemedParamCentered<gtgBlueTinyKnob>(mm2px(Vec(x, 58.5)), module, Console::BLUE_PARAMS + s, module ? &module->color_theme : NULL));
+			addParam(createThemedParamCentered<gtgOrangeTinyKnob>(mm2px(Vec(x, 69.5)), module, Console::ORANGE_PARAMS + s, module ? &module->color_theme : NULL));
+			addParam(createThemedParamCentered<gtgRedTinyKnob>(mm2px(Vec(x, 80.5)), module, Console::RED_PARAMS + s, module ? &module->color_theme : NULL));
+			addInput(createThemedPortCentered<gtgKeyPort>(mm2px(Vec(x, 92.0)), true, module, Console::LEVEL_CV_INPUTS + s, module ? &module->color_theme : NULL));
+			addInput(createThemedPortCentered<gtgKeyPort>(mm2px(Vec(x, 102.5)), true, module, Console::ON_CV_INPUTS + s, module ? &module->color_theme : NULL));
+		}
+
+		addInput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(86.36, 103.85)), true, module, Console::BUS_INPUT, module ? &module->color_theme : NULL));
+		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(86.36, 114.1)), false, module, Console::BUS_OUTPUT, module ? &module->color_theme : NULL));
+	}
+
+	// create menu
+	void appendContextMenu(Menu* menu) override {
+		Console* module = dynamic_cast<Console*>(this->module);
+
+		// set post fader sends on blue and orange buses
+		struct PostFadeItem : MenuItem {
+			Console *module;
+			int post_fade;
+			void onAction(const event::Action &e) override {
+				module->post_fades = post_fade;
+			}
+		};
+
+		struct PostFadesItem : MenuItem {
+			Console *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string fade_titles[2] = {"Normal faders", "Post red fader sends (default)"};
+				int post_mode[2] = {0, 1};
+				for (int i = 0; i < 2; i++) {
+					PostFadeItem *post_item = new PostFadeItem;
+					post_item->text = fade_titles[i];
+					post_item->rightText = CHECKMARK(module->post_fades == post_mode[i]);
+					post_item->module = module;
+					post_item->post_fade = post_mode[i];
+					menu->addChild(post_item);
+				}
+				return menu;
+			}
+		};
+
+		struct ThemeItem : MenuItem {
+			Console* module;
+			int theme;
+			void onAction(const event::Action& e) override {
+				if (theme == 10) {
+					module->use_default_theme = true;
+					module->color_theme = gtg_default_theme;
+				} else {
+					module->use_default_theme = false;
+					module->color_theme = theme;
+				}
+				notifyGtgThemeChange();
+			}
+		};
+
+		struct DefaultThemeItem : MenuItem {
+			Console* module;
+			int theme;
+			void onAction(const event::Action &e) override {
+				gtg_default_theme = theme;
+				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
+			}
+		};
+
+		struct ThemesItem : MenuItem {
+			Console *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string theme_titles[3] = {"Default", "70's Cream", "Night Ride"};
+				int theme_selected[3] = {10, 0, 1};
+				for (int i = 0; i < 3; i++) {
+					ThemeItem *theme_item = new ThemeItem;
+					theme_item->text = theme_titles[i];
+					if (i == 0) {
+						theme_item->rightText = CHECKMARK(module->use_default_theme);
+					} else {
+						if (!module->use_default_theme) {
+							theme_item->rightText = CHECKMARK(module->color_theme == theme_selected[i]);
+						}
+					}
+					theme_item->module = module;
+					theme_item->theme = theme_selected[i];
+					menu->addChild(theme_item);
+				}
+				menu->addChild(new MenuEntry);
+				std::string default_theme_titles[2] = {"Default to 70's Cream", "Default to Night Ride"};
+				for (int i = 0; i < 2; i++) {
+					DefaultThemeItem *default_theme_item = new DefaultThemeItem;
+					default_theme_item->text = default_theme_titles[i];
+					default_theme_item->rightText = CHECKMARK(gtg_default_theme == i);
+					default_theme_item->module = module;
+					default_theme_item->theme = i;
+					menu->addChild(default_theme_item);
+				}
+				return menu;
+			}
+		};
+
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Fade Automation"));
+
+		FadeSliderItem *fadeInSliderItem = new FadeSliderItem(&(module->fade_in), "In");
+		fadeInSliderItem->box.size.x = 190.f;
+		menu->addChild(fadeInSliderItem);
+
+		FadeSliderItem *fadeOutSliderItem = new FadeSliderItem(&(module->fade_out), "Out");
+		fadeOutSliderItem->box.size.x = 190.f;
+		menu->addChild(fadeOutSliderItem);
+
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Mixer Settings"));
+
+		PostFadesItem *postFadesItem = createMenuItem<PostFadesItem>("Blue and Orange Levels");
+		postFadesItem->rightText = RIGHT_ARROW;
+		postFadesItem->module = module;
+		menu->addChild(postFadesItem);
+
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		AuditionGroupsItem *auditionGroupsItem = createMenuItem<AuditionGroupsItem>("Audition Group");
+		auditionGroupsItem->rightText = RIGHT_ARROW;
+		auditionGroupsItem->audition = &(module->audition);
+		menu->addChild(auditionGroupsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
+#ifndef USING_CARDINAL_NOT_RACK
+		menu->addChild(new MenuEntry);
+
+		ThemesItem *themesItem = createMenuItem<ThemesItem>("Panel Themes");
+		themesItem->rightText = RIGHT_ARROW;
+		themesItem->module = module;
+		menu->addChild(themesItem);
+#endif
+	}
+
+	// display panel and components when the theme changes
+	void step() override {
+#ifdef USING_CARDINAL_NOT_RACK
+		showGtgNightPanel(this, night_panel, "Console", settings::darkMode);
+#endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			Console *themed_module = (Console*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "Console", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
+		Widget::step();
+	}
+};
+
+
+Model *modelConsole = createModel<Console, ConsoleWidget>("Console");
@@ -1,5 +1,7 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
+#include "gtgDSP.hpp"
+#include "gtgStations.hpp"
 
 
 struct EnterBus : Module {
@@ -20,8 +22,9 @@ struct EnterBus : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::ClockDivider housekeeping_divider;
 
+	int bus_rig = 0;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
@@ -38,43 +41,51 @@ struct EnterBus : Module {
 		configInput(ENTER_INPUTS + 5, "Red right");
 		configInput(BUS_INPUT, "Bus chain");
 		configOutput(BUS_OUTPUT, "Bus chain");
-		housekeeping_divider.setDivision(50000);
 		gtg_default_theme = loadGtgPluginDefault("default_theme", 0);
 		color_theme = gtg_default_theme;
 	}
 
 	void process(const ProcessArgs &args) override {
 
-		if (housekeeping_divider.process()) {
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
+		// process all inputs and levels to the selected rig
+		float bus_sends[6];
+		for (int c = 0; c < 6; c++) {
+			bus_sends[c] = inputs[ENTER_INPUTS + c].getVoltage() * params[LEVEL_PARAMS + (c / 2)].getValue();
 		}
 
-		// process all inputs and levels to bus
-		outputs[BUS_OUTPUT].setVoltage((inputs[ENTER_INPUTS + 0].getVoltage() * params[LEVEL_PARAMS + 0].getValue()) + inputs[BUS_INPUT].getPolyVoltage(0), 0);
-		outputs[BUS_OUTPUT].setVoltage((inputs[ENTER_INPUTS + 1].getVoltage() * params[LEVEL_PARAMS + 0].getValue()) + inputs[BUS_INPUT].getPolyVoltage(1), 1);
-		outputs[BUS_OUTPUT].setVoltage((inputs[ENTER_INPUTS + 2].getVoltage() * params[LEVEL_PARAMS + 1].getValue()) + inputs[BUS_INPUT].getPolyVoltage(2), 2);
-		outputs[BUS_OUTPUT].setVoltage((inputs[ENTER_INPUTS + 3].getVoltage() * params[LEVEL_PARAMS + 1].getValue()) + inputs[BUS_INPUT].getPolyVoltage(3), 3);
-		outputs[BUS_OUTPUT].setVoltage((inputs[ENTER_INPUTS + 4].getVoltage() * params[LEVEL_PARAMS + 2].getValue()) + inputs[BUS_INPUT].getPolyVoltage(4), 4);
-		outputs[BUS_OUTPUT].setVoltage((inputs[ENTER_INPUTS + 5].getVoltage() * params[LEVEL_PARAMS + 2].getValue()) + inputs[BUS_INPUT].getPolyVoltage(5), 5);
+		// set output to 3 stereo buses on each rig
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.addRig(bus_rig, bus_sends);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
+	}
 
-		// set output to 3 stereo buses
-		outputs[BUS_OUTPUT].setChannels(6);
+	// pass the bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUT], outputs[BUS_OUTPUT]);
 	}
 
 	// save color theme
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
 		return rootJ;
 	}
 
 	// load color theme
 	void dataFromJson(json_t *rootJ) override {
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
@@ -85,22 +96,12 @@ struct EnterBus : Module {
 };
 
 struct EnterBusWidget : ModuleWidget {
-	SvgPanel* night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	EnterBusWidget(EnterBus *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/EnterBus.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/EnterBus_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("EnterBus", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
@@ -120,7 +121,6 @@ struct EnterBusWidget : ModuleWidget {
 		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(7.62, 114.107)), false, module, EnterBus::BUS_OUTPUT, module ? &module->color_theme : NULL));
 	}
 
-#ifndef USING_CARDINAL_NOT_RACK
 	// build the menu
 	void appendContextMenu(Menu* menu) override {
 		EnterBus* module = dynamic_cast<EnterBus*>(this->module);
@@ -136,6 +136,7 @@ struct EnterBusWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -145,6 +146,7 @@ struct EnterBusWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -184,26 +186,39 @@ struct EnterBusWidget : ModuleWidget {
 
 		menu->addChild(new MenuEntry);
 
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
+#ifndef USING_CARDINAL_NOT_RACK
+		menu->addChild(new MenuEntry);
+
 		ThemesItem *themesItem = createMenuItem<ThemesItem>("Panel Themes");
 		themesItem->rightText = RIGHT_ARROW;
 		themesItem->module = module;
 		menu->addChild(themesItem);
-	}
 #endif
+	}
 
-	// display the panel based on the theme
+	// display the panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((EnterBus*)module)->color_theme) == 0);
-			night_panel->visible = ((((EnterBus*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "EnterBus", settings::darkMode);
+#endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			EnterBus *themed_module = (EnterBus*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "EnterBus", themed_module->color_theme == 1);
 #endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
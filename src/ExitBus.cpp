@@ -1,5 +1,7 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
+#include "gtgDSP.hpp"
+#include "gtgStations.hpp"
 
 
 struct ExitBus : Module {
@@ -19,8 +21,9 @@ struct ExitBus : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::ClockDivider housekeeping_divider;
 
+	int bus_rig = 0;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
@@ -34,26 +37,32 @@ struct ExitBus : Module {
 		configOutput(EXIT_OUTPUTS + 4, "Red left");
 		configOutput(EXIT_OUTPUTS + 5, "Red right");
 		configOutput(BUS_OUTPUT, "Bus chain");
-		housekeeping_divider.setDivision(50000);
 		gtg_default_theme = loadGtgPluginDefault("default_theme", 0);
 		color_theme = gtg_default_theme;
 	}
 
 	void process(const ProcessArgs &args) override {
 
-		if (housekeeping_divider.process()) {
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
-		}
+		// pass all channels of both rigs along the chain
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
 
-		// set output to 3 stereo buses
-		outputs[BUS_OUTPUT].setChannels(6);
+		// exit the selected rig
+		float bus_exits[6];
+		bus_frame.getRig(bus_rig, bus_exits);
+		for (int c = 0; c < 6; c++) {
+			outputs[EXIT_OUTPUTS + c].setVoltage(bus_exits[c]);
+		}
+	}
 
-		// process all inputs and outputs
+	// pass the bus chain through when bypassed, exits are silent
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUT], outputs[BUS_OUTPUT]);
 		for (int c = 0; c < 6; c++) {
-			outputs[EXIT_OUTPUTS + c].setVoltage(inputs[BUS_INPUT].getPolyVoltage(c));
-			outputs[BUS_OUTPUT].setVoltage(inputs[BUS_INPUT].getPolyVoltage(c), c);
+			outputs[EXIT_OUTPUTS + c].setVoltage(0.f);
 		}
 	}
 
@@ -61,14 +70,21 @@ struct ExitBus : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
 		return rootJ;
 	}
 
 	// load color theme
 	void dataFromJson(json_t *rootJ) override {
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
@@ -79,22 +95,12 @@ struct ExitBus : Module {
 
 
 struct ExitBusWidget : ModuleWidget {
-	SvgPanel* night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	ExitBusWidget(ExitBus *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/ExitBus.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/ExitBus_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("ExitBus", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
@@ -110,7 +116,6 @@ struct ExitBusWidget : ModuleWidget {
 		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(7.62, 114.107)), false, module, ExitBus::BUS_OUTPUT, module ? &module->color_theme : NULL));
 	}
 
-#ifndef USING_CARDINAL_NOT_RACK
 	// build the menu
 	void appendContextMenu(Menu* menu) override {
 		ExitBus* module = dynamic_cast<ExitBus*>(this->module);
@@ -126,6 +131,7 @@ struct ExitBusWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -135,6 +141,7 @@ struct ExitBusWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -174,26 +181,39 @@ struct ExitBusWidget : ModuleWidget {
 
 		menu->addChild(new MenuEntry);
 
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
+#ifndef USING_CARDINAL_NOT_RACK
+		menu->addChild(new MenuEntry);
+
 		ThemesItem *themesItem = createMenuItem<ThemesItem>("Panel Themes");
 		themesItem->rightText = RIGHT_ARROW;
 		themesItem->module = module;
 		menu->addChild(themesItem);
-	}
 #endif
+	}
 
-	// display the panel based on the theme
+	// display the panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((ExitBus*)module)->color_theme) == 0);
-			night_panel->visible = ((((ExitBus*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "ExitBus", settings::darkMode);
 #endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			ExitBus *themed_module = (ExitBus*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "ExitBus", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
@@ -1,6 +1,8 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
 #include "gtgDSP.hpp"
+#include "gtgAudition.hpp"
+#include "gtgStations.hpp"
 
 
 struct GigBus : Module {
@@ -23,8 +25,6 @@ struct GigBus : Module {
 	};
 	enum LightIds {
 		ENUMS(ON_LIGHT, 2),
-		ENUMS(LEFT_LIGHTS, 11),
-		ENUMS(RIGHT_LIGHTS, 11),
 		NUM_LIGHTS
 	};
 
@@ -38,6 +38,7 @@ struct GigBus : Module {
 	dsp::ClockDivider pan_divider;
 	AutoFader gig_fader;
 	ConstantPan gig_pan;
+	PolyPan gig_poly_pan;
 	SimpleSlewer post_fade_filter;
 
 	const int bypass_speed = 26;
@@ -46,8 +47,15 @@ struct GigBus : Module {
 	float fade_out = 26.f;
 	bool auto_override = false;
 	bool post_fades = true;
+	int poly_mode = 0;   // 0 sums polyphonic voices, 1 pans each voice
+	float poly_spread = 0.f;
 	bool auditioned = false;
+	AuditionFollower audition{mixer_auditions};
 	float peak_stereo[2] = {0.f, 0.f};
+	std::atomic<float> vu_levels[2] = {{0.f}, {0.f}};   // snapshots for the vu meter widgets
+	std::atomic<float> vu_peaks[2] = {{0.f}, {0.f}};
+	int bus_rig = 0;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
@@ -73,17 +81,18 @@ struct GigBus : Module {
 		gig_fader.setSpeed(fade_in);
 		post_fade_filter.setSlewSpeed(smooth_speed);
 		post_fade_filter.value = 1.f;
+		gig_poly_pan.setSlewSpeed(smooth_speed);
 		gtg_default_theme = loadGtgPluginDefault("default_theme", 0);
 		color_theme = gtg_default_theme;
 	}
 
 	void process(const ProcessArgs &args) override {
 
-		// check default theme and reset vu meters
+		// audition changes apply on the same frame in every mixer of the audition group
+		bool audition_changed = audition.process(args.frame);
+
+		// reset vu meters
 		if (housekeeping_divider.process()) {
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
 			vu_meters[0].v = 0.f;
 			vu_meters[1].v = 0.f;
 		}
@@ -94,8 +103,8 @@ struct GigBus : Module {
 		case LongPressButton::NO_PRESS:
 			break;
 		case LongPressButton::SHORT_PRESS:
-			if (audition_mixer) {
-				audition_mixer = false;   // single click turns off auditions
+			if (audition.active) {
+				audition.set(false, args.frame);   // single click turns off auditions
 			} else {
 				if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL) {   // bypass fades with ctrl click
 					auto_override = true;
@@ -121,7 +130,7 @@ struct GigBus : Module {
 			break;
 		case LongPressButton::LONG_PRESS:   // long press to audition
 
-			audition_mixer = true;   // all mixers to audition mode
+			audition.set(true, args.frame);   // all mixers to audition mode
 
 			if (auditioned) {
 				auditioned = false;
@@ -140,7 +149,7 @@ struct GigBus : Module {
 
 		// process cv trigger
 		if (on_cv_trigger.process(inputs[ON_CV_INPUT].getVoltage())) {
-			if (!audition_mixer) {
+			if (!audition.active) {
 				auto_override = false;   // do not override automation
 				gig_fader.on = !gig_fader.on;
 			}
@@ -148,8 +157,9 @@ struct GigBus : Module {
 
 		gig_fader.process();
 
-		if (audition_divider.process()) {
-			if (audition_mixer) {   // all mixers are in audition state
+		// apply audition changes on the same frame as other mixers
+		if (audition_changed) {
+			if (audition.active) {   // all mixers are in audition state
 
 				// bypass all fade automation
 				auto_override = true;
@@ -180,7 +190,9 @@ struct GigBus : Module {
 				// turn off auditions
 				auditioned = false;
 			}
+		}
 
+		if (audition_divider.process()) {
 			// process fade speed changes if dragging slider
 			if (!auto_override) {
 				if (gig_fader.on) {
@@ -217,6 +229,9 @@ struct GigBus : Module {
 		// get stereo pan levels
 		if (pan_divider.process()) {   // optimized by checking pan every few samples
 			gig_pan.setPan(params[PAN_PARAM].getValue());
+			if (poly_mode == 1) {
+				gig_poly_pan.setSpread(params[PAN_PARAM].getValue(), poly_spread, inputs[LMP_INPUT].getChannels());
+			}
 		}
 
 		// get exponential fade
@@ -232,6 +247,12 @@ struct GigBus : Module {
 		if (inputs[R_INPUT].isConnected()) {   // get a channel from each cable input
 			stereo_in[0] = inputs[LMP_INPUT].getVoltage() * gig_pan.getLevel(0) * exp_fade;
 			stereo_in[1] = inputs[R_INPUT].getVoltage() * gig_pan.getLevel(1) * exp_fade;
+		} else if (poly_mode == 1) {   // pan each voice of polyphonic cable on LMP
+			gig_poly_pan.slewLevels();
+			gig_poly_pan.mix(inputs[LMP_INPUT], stereo_in);
+			for (int c = 0; c < 2; c++) {
+				stereo_in[c] *= exp_fade;
+			}
 		} else {   // split mono or sum of polyphonic cable on LMP
 			float lmp_in = inputs[LMP_INPUT].getVoltageSum();
 			for (int c = 0; c < 2; c++) {
@@ -257,7 +278,7 @@ struct GigBus : Module {
 
 			// set on light
 			if (gig_fader.getFade() == gig_fader.getGain()) {
-				if (audition_mixer) {
+				if (audition.active) {
 					lights[ON_LIGHT + 0].value = 1.f;   // yellow when auditioned
 					lights[ON_LIGHT + 1].value = 1.f;
 				} else {
@@ -274,40 +295,33 @@ struct GigBus : Module {
 				}
 			}
 
-			// make peak lights stay on when hit
+			// make peak lights stay on when hit and snapshot the vu meters
 			for (int c = 0; c < 2; c++) {
 				if (peak_stereo[c] > 0) peak_stereo[c] -= 120.f / args.sampleRate; else peak_stereo[c] = 0.f;
+				vu_peaks[c].store(peak_stereo[c], std::memory_order_relaxed);
+				vu_levels[c].store(vu_meters[c].v, std::memory_order_relaxed);
 			}
-			lights[LEFT_LIGHTS + 0].setBrightness(peak_stereo[0]);
-			lights[RIGHT_LIGHTS + 0].setBrightness(peak_stereo[1]);
+		}
 
-			// green and yellow vu lights
-			for (int i = 1; i < 6; i++) {
-				lights[LEFT_LIGHTS + i].setBrightness(vu_meters[0].getBrightness((-3 * i), -3 * (i - 1)));
-				lights[RIGHT_LIGHTS + i].setBrightness(vu_meters[1].getBrightness((-3 * i), -3 * (i - 1)));
-			}
-			lights[LEFT_LIGHTS + 6].setBrightness(vu_meters[0].getBrightness(-19, -15));
-			lights[RIGHT_LIGHTS + 6].setBrightness(vu_meters[1].getBrightness(-19, -15));
-			lights[LEFT_LIGHTS + 7].setBrightness(vu_meters[0].getBrightness(-24, -19));
-			lights[RIGHT_LIGHTS + 7].setBrightness(vu_meters[1].getBrightness(-24, -19));
-			lights[LEFT_LIGHTS + 8].setBrightness(vu_meters[0].getBrightness(-30, -24));
-			lights[RIGHT_LIGHTS + 8].setBrightness(vu_meters[1].getBrightness(-30, -24));
-			lights[LEFT_LIGHTS + 9].setBrightness(vu_meters[0].getBrightness(-36, -28));
-			lights[RIGHT_LIGHTS + 9].setBrightness(vu_meters[1].getBrightness(-36, -28));
-			lights[LEFT_LIGHTS + 10].setBrightness(vu_meters[0].getBrightness(-48, -36));
-			lights[RIGHT_LIGHTS + 10].setBrightness(vu_meters[1].getBrightness(-48, -36));
+		// get sends for 3 stereo buses
+		float bus_sends[6];
+		for (int sb = 0; sb < 3; sb++) {   // sb = stereo bus
+			bus_sends[(2 * sb) + 0] = stereo_in[0] * in_levels[sb];
+			bus_sends[(2 * sb) + 1] = stereo_in[1] * in_levels[sb];
 		}
 
-		// process outputs
-		outputs[BUS_OUTPUT].setVoltage((stereo_in[0] * in_levels[0]) + inputs[BUS_INPUT].getPolyVoltage(0), 0);
-		outputs[BUS_OUTPUT].setVoltage((stereo_in[1] * in_levels[0]) + inputs[BUS_INPUT].getPolyVoltage(1), 1);
-		outputs[BUS_OUTPUT].setVoltage((stereo_in[0] * in_levels[1]) + inputs[BUS_INPUT].getPolyVoltage(2), 2);
-		outputs[BUS_OUTPUT].setVoltage((stereo_in[1] * in_levels[1]) + inputs[BUS_INPUT].getPolyVoltage(3), 3);
-		outputs[BUS_OUTPUT].setVoltage((stereo_in[0] * in_levels[2]) + inputs[BUS_INPUT].getPolyVoltage(4), 4);
-		outputs[BUS_OUTPUT].setVoltage((stereo_in[1] * in_levels[2]) + inputs[BUS_INPUT].getPolyVoltage(5), 5);
+		// process outputs, sends go to the selected rig and the other rig passes through
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.addRig(bus_rig, bus_sends);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
+	}
 
-		// set bus outputs for 3 stereo buses out
-		outputs[BUS_OUTPUT].setChannels(6);
+	// pass the bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUT], outputs[BUS_OUTPUT]);
 	}
 
 	// save on button and gain states
@@ -315,14 +329,19 @@ struct GigBus : Module {
 		json_t *rootJ = json_object();
 		json_object_set_new(rootJ, "input_on", json_integer(gig_fader.on));
 		json_object_set_new(rootJ, "post_fades", json_integer(post_fades));
+		json_object_set_new(rootJ, "poly_mode", json_integer(poly_mode));
+		json_object_set_new(rootJ, "poly_spread", json_real(poly_spread));
 		json_object_set_new(rootJ, "gain", json_real(gig_fader.getGain()));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
 		json_object_set_new(rootJ, "fade_in", json_real(fade_in));
 		json_object_set_new(rootJ, "fade_out", json_real(fade_out));
-		json_object_set_new(rootJ, "audition_mixer", json_integer(audition_mixer));
+		json_object_set_new(rootJ, "audition_mixer", json_integer(audition.isActive()));
+		json_object_set_new(rootJ, "audition_group", json_integer(audition.group));
 		json_object_set_new(rootJ, "auditioned", json_integer(auditioned));
 		json_object_set_new(rootJ, "temped", json_integer(gig_fader.temped));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
 		return rootJ;
 	}
 
@@ -332,39 +351,51 @@ struct GigBus : Module {
 		if (input_onJ) gig_fader.on = json_integer_value(input_onJ);
 		json_t *post_fadesJ = json_object_get(rootJ, "post_fades");
 		if (post_fadesJ) post_fades = json_integer_value(post_fadesJ);
+		json_t *poly_modeJ = json_object_get(rootJ, "poly_mode");
+		if (poly_modeJ) poly_mode = json_integer_value(poly_modeJ);
+		json_t *poly_spreadJ = json_object_get(rootJ, "poly_spread");
+		if (poly_spreadJ) poly_spread = json_real_value(poly_spreadJ);
 		json_t *gainJ = json_object_get(rootJ, "gain");
 		if (gainJ) gig_fader.setGain((float)json_real_value(gainJ));
 		json_t *fade_inJ = json_object_get(rootJ, "fade_in");
 		if (fade_inJ) fade_in = json_real_value(fade_inJ);
 		json_t *fade_outJ = json_object_get(rootJ, "fade_out");
 		if (fade_outJ) fade_out = json_real_value(fade_outJ);
+		json_t *audition_groupJ = json_object_get(rootJ, "audition_group");
+		if (audition_groupJ) audition.setGroup(json_integer_value(audition_groupJ));
 		json_t *audition_mixerJ = json_object_get(rootJ, "audition_mixer");
 		if (audition_mixerJ) {
-			audition_mixer = json_integer_value(audition_mixerJ);
+			audition.set(json_integer_value(audition_mixerJ), APP->engine->getFrame());
 		} else {
-			audition_mixer = false;   // no auditioning when loading old patch right after auditioned patch
+			audition.set(false, APP->engine->getFrame());   // no auditioning when loading old patch right after auditioned patch
 		}
 		json_t *auditionedJ = json_object_get(rootJ, "auditioned");
 		if (auditionedJ) auditioned = json_integer_value(auditionedJ);
 		json_t *tempedJ = json_object_get(rootJ, "temped");
 		if (tempedJ) gig_fader.temped = json_integer_value(tempedJ);
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
 		} else {
 			if (input_onJ) use_default_theme = false;   // do not change existing patches
 		}
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
 	}
 
-	// reset fader speed with new sample rate
+	// reset fader and spread speeds with new sample rate
 	void onSampleRateChange() override {
 		if (gig_fader.on) {
 			gig_fader.setSpeed(fade_in);
 		} else {
 			gig_fader.setSpeed(fade_out);
 		}
+		gig_poly_pan.setSlewSpeed(smooth_speed);
 	}
 
 	// reset on state on initialize
@@ -374,28 +405,23 @@ struct GigBus : Module {
 		fade_in = 26.f;
 		fade_out = 26.f;
 		post_fades = true;
-		audition_mixer = false;
+		poly_mode = 0;
+		poly_spread = 0.f;
+		bus_rig = 0;
+		audition.set(false, APP->engine->getFrame());
+		audition.setGroup(0);
+		station_publisher.station = -1;
 	}
 };
 
 
 struct GigBusWidget : ModuleWidget {
-	SvgPanel *night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	GigBusWidget(GigBus *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/GigBus.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/GigBus_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("GigBus", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
@@ -414,23 +440,9 @@ struct GigBusWidget : ModuleWidget {
 
 		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(10.13, 114.108)), false, module, GigBus::BUS_OUTPUT, module ? &module->color_theme : NULL));
 
-		// create vu lights
-		for (int i = 0; i < 11; i++) {
-			float spacing = i * 3.25f;
-			float top = 15.f;
-			if (i < 1 ) {
-				addChild(createLightCentered<SmallLight<RedLight>>(mm2px(Vec(3.27, top + spacing)), module, GigBus::LEFT_LIGHTS + i));
-				addChild(createLightCentered<SmallLight<RedLight>>(mm2px(Vec(17.0, top + spacing)), module, GigBus::RIGHT_LIGHTS + i));
-			} else {
-				if (i < 2) {
-					addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(3.27, top + spacing)), module, GigBus::LEFT_LIGHTS + i));
-					addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(17.0, top + spacing)), module, GigBus::RIGHT_LIGHTS + i));
-				} else {
-					addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(3.27, top + spacing)), module, GigBus::LEFT_LIGHTS + i));
-					addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(17.0, top + spacing)), module, GigBus::RIGHT_LIGHTS + i));
-				}
-			}
-		}
+		// create vu meters
+		addChild(createGtgVuMeter(Vec(3.27, 15.0), 3.25, 1.088, module ? &module->vu_levels[0] : NULL, module ? &module->vu_peaks[0] : NULL));
+		addChild(createGtgVuMeter(Vec(17.0, 15.0), 3.25, 1.088, module ? &module->vu_levels[1] : NULL, module ? &module->vu_peaks[1] : NULL));
 	}
 
 	// build the context menu
@@ -490,6 +502,36 @@ struct GigBusWidget : ModuleWidget {
 			}
 		};
 
+		// set summed or panned voices on polyphonic cables
+		struct PolyModeItem : MenuItem {
+			GigBus *module;
+			int poly_mode;
+			void onAction(const event::Action &e) override {
+				module->poly_mode = poly_mode;
+			}
+		};
+
+		struct PolyModesItem : MenuItem {
+			GigBus *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string mode_titles[2] = {"Sum voices (default)", "Pan each voice"};
+				for (int i = 0; i < 2; i++) {
+					PolyModeItem *poly_item = new PolyModeItem;
+					poly_item->text = mode_titles[i];
+					poly_item->rightText = CHECKMARK(module->poly_mode == i);
+					poly_item->module = module;
+					poly_item->poly_mode = i;
+					menu->addChild(poly_item);
+				}
+				menu->addChild(new MenuEntry);
+				PolySpreadSliderItem *polySpreadSliderItem = new PolySpreadSliderItem(&(module->poly_spread));
+				polySpreadSliderItem->box.size.x = 190.f;
+				menu->addChild(polySpreadSliderItem);
+				return menu;
+			}
+		};
+
 		struct ThemeItem : MenuItem {
 			GigBus* module;
 			int theme;
@@ -501,6 +543,7 @@ struct GigBusWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -510,6 +553,7 @@ struct GigBusWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -573,6 +617,26 @@ struct GigBusWidget : ModuleWidget {
 		postFadesItem->module = module;
 		menu->addChild(postFadesItem);
 
+		PolyModesItem *polyModesItem = createMenuItem<PolyModesItem>("Polyphonic Input");
+		polyModesItem->rightText = RIGHT_ARROW;
+		polyModesItem->module = module;
+		menu->addChild(polyModesItem);
+
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		AuditionGroupsItem *auditionGroupsItem = createMenuItem<AuditionGroupsItem>("Audition Group");
+		auditionGroupsItem->rightText = RIGHT_ARROW;
+		auditionGroupsItem->audition = &(module->audition);
+		menu->addChild(auditionGroupsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
 #ifndef USING_CARDINAL_NOT_RACK
 		menu->addChild(new MenuEntry);
 
@@ -583,19 +647,19 @@ struct GigBusWidget : ModuleWidget {
 #endif
 	}
 
-	// display panel based on theme
+	// display panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((GigBus*)module)->color_theme) == 0);
-			night_panel->visible = ((((GigBus*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "GigBus", settings::darkMode);
 #endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			GigBus *themed_module = (GigBus*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "GigBus", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
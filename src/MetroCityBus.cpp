@@ -1,10 +1,38 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
 #include "gtgDSP.hpp"
+#include "gtgAudition.hpp"
+#include "gtgStations.hpp"
 
 
-const long HISTORY_CAP = 512000;
-const float pan_division = 3.f;
+
+// spread knob tooltip also reports the module's memory, which grows with the pan follow history
+struct SpreadQuantity : ParamQuantity {
+	std::atomic<long> *memory_bytes = NULL;
+	std::atomic<long> *history_bytes = NULL;
+	std::string getDescription() override {
+		if (!memory_bytes) return ParamQuantity::getDescription();
+		return string::f("Memory: %.1f kB, with %.1f kB of pan follow history", *memory_bytes / 1024.f, *history_bytes / 1024.f);
+	}
+};
+
+
+// pan light snapshot written by process() and read by the widget
+struct PanLightSnapshot {
+	std::atomic<float> pans[16];
+	std::atomic<float> volts[16];
+	std::atomic<int> channels{0};
+	std::atomic<bool> on{false};
+	std::atomic<float> decay{0.f};
+
+	PanLightSnapshot() {
+		for (int c = 0; c < 16; c++) {
+			pans[c].store(0.f);
+			volts[c].store(0.f);
+		}
+	}
+};
+
 
 struct MetroCityBus : Module {
 	enum ParamIds {
@@ -48,9 +76,21 @@ struct MetroCityBus : Module {
 	dsp::ClockDivider pan_light_divider;
 	dsp::ClockDivider light_divider;
 	AutoFader metro_fader;
-	ConstantPan metro_pan[16];
+	ConstantPan follow_pan;   // first voice of pan follow
+	simd::float_4 follow_levels[2][4];   // left and right levels of the 16 voices for pan follow, in mix order
+	PolyPan spread_pan;   // cached voice levels for spread without pan CV
+	int spread_pattern = SPREAD_LINEAR;
+	uint32_t spread_seed = 1;
+	bool following = false;   // pan follow when pan CV is connected
+	bool follow_summing = true;   // followed voices share one position when there is no spread
+	simd::float_4 voice_envelopes[4] = {};
+	int voice_activity = 0;   // bit for each voice that is not silent
+	float envelope_decay = 0.f;
+	const float activity_threshold = 0.0001f;
 	SimpleSlewer level_smoother[3];
 	SimpleSlewer post_btn_filters[2];
+	VectorSlewer voice_level_smoothers[3][4];   // per voice levels with polyphonic level CV
+	SimpleSlewer post_voice_filters[2];
 
 	const int bypass_speed = 26;   // milliseconds from 0 to gain
 	const int smooth_speed = 86;   // milliseconds from full left to full right
@@ -59,26 +99,34 @@ struct MetroCityBus : Module {
 	float fade_out = 26.f;
 	bool auto_override = false;
 	bool auditioned = false;
-	float pan_history[HISTORY_CAP] = {};
-	long hist_i = 0;
-	long hist_size = 0;
+	AuditionFollower audition{mixer_auditions};
+	PanHistory pan_history;
+	std::atomic<long> history_bytes{0};
+	std::atomic<long> memory_bytes{0};
 	bool reverse_poly = false;
 	bool post_fades[2] = {false, false};
 	float spread_pos = 0.f;
 	int channel_no = 0;
 	float light_pan[16] = {};
-	float light_delta = 2.f / 8.f;   // 8 divisions because light 1 and 9 are halved by offset
-	float light_brights[9] = {};
-	long f_delay = 0;   // follow delay
+	PanLightSnapshot light_frames[2];   // voice pans and voltages for the pan lights, binned on the UI side
+	std::atomic<int> light_snapshots{0};   // the latest snapshot is in light_frames[light_snapshots & 1]
+	float f_delay = 0.f;   // follow delay in history steps
+	int pan_division = 3;   // pan and pan follow history are calculated every few samples
+	std::atomic<int> requested_division{3};   // set from the menu and json, applied in process()
 	float pan_rate = APP->engine->getSampleRate() / pan_division;   // to work with pan clock divider
 	bool level_cv_filter = true;
+	int bus_rig = 0;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
 	MetroCityBus() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(ON_PARAM, 0.f, 1.f, 0.f, "Input on");
-		configParam(SPREAD_PARAM, -1.f, 1.f, 0.f, "Polyphonic stereo spread");
+		SpreadQuantity *spread_quantity = configParam<SpreadQuantity>(SPREAD_PARAM, -1.f, 1.f, 0.f, "Polyphonic stereo spread");
+		spread_quantity->memory_bytes = &memory_bytes;
+		spread_quantity->history_bytes = &history_bytes;
+		memory_bytes = sizeof(MetroCityBus);
 		configParam(PAN_ATT_PARAM, 0.f, 1.f, 0.5f, "Pan attenuator");
 		configParam(REVERSE_PARAM, 0.f, 1.f, 0.f, "Reverse pan order of polyphonic channels");
 		configParam(PAN_PARAM, -1.f, 1.f, 0.f, "Pan");
@@ -90,9 +138,9 @@ struct MetroCityBus : Module {
 		configInput(POLY_INPUT, "Poly");
 		configInput(ON_CV_INPUT, "On CV");
 		configInput(PAN_CV_INPUT, "Pan poly follow CV (-5.0 to 5.0)");
-		configInput(LEVEL_CV_INPUTS + 0, "Blue level CV");
-		configInput(LEVEL_CV_INPUTS + 1, "Orange level CV");
-		configInput(LEVEL_CV_INPUTS + 2, "Red level CV");
+		configInput(LEVEL_CV_INPUTS + 0, "Blue level CV (polyphonic for each voice)");
+		configInput(LEVEL_CV_INPUTS + 1, "Orange level CV (polyphonic for each voice)");
+		configInput(LEVEL_CV_INPUTS + 2, "Red level CV (polyphonic for each voice)");
 		configInput(BUS_INPUT, "Bus chain");
 		configOutput(BUS_OUTPUT, "Bus chain");
 		pan_divider.setDivision(pan_division);
@@ -100,11 +148,8 @@ struct MetroCityBus : Module {
 		light_divider.setDivision(512);
 		metro_fader.setSpeed(fade_in);
 		initializePanObjects();
-		for (int i = 0; i < 3; i++) {
-			level_smoother[i].setSlewSpeed(level_speed);
-		}
+		setLevelSpeeds();
 		for (int i = 0; i < 2; i++) {
-			post_btn_filters[i].setSlewSpeed(level_speed);
 			post_btn_filters[i].value = 1.f;
 		}
 		post_fades[0] = loadGtgPluginDefault("default_post_fader", 0);
@@ -115,14 +160,21 @@ struct MetroCityBus : Module {
 
 	void process(const ProcessArgs &args) override {
 
+		// audition changes apply on the same frame in every mixer of the audition group
+		bool audition_changed = audition.process(args.frame);
+
+		// apply a new pan rate, only the audio thread touches the pan history
+		int division = requested_division.load(std::memory_order_relaxed);
+		if (division != pan_division) applyPanDivision(division);
+
 		// on off button
 		switch (on_button.step(params[ON_PARAM])) {
 		default:
 		case LongPressButton::NO_PRESS:
 			break;
 		case LongPressButton::SHORT_PRESS:
-			if (audition_mixer) {
-				audition_mixer = false;   // single click turns off auditions
+			if (audition.active) {
+				audition.set(false, args.frame);   // single click turns off auditions
 			} else {
 				if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL) {   // bypass fades with ctrl click
 					auto_override = true;
@@ -148,7 +200,7 @@ struct MetroCityBus : Module {
 			break;
 		case LongPressButton::LONG_PRESS:   // long press to audition
 
-			audition_mixer = true;   // all mixers to audition mode
+			audition.set(true, args.frame);   // all mixers to audition mode
 
 			if (auditioned) {
 				auditioned = false;
@@ -169,7 +221,7 @@ struct MetroCityBus : Module {
 
 		// process cv trigger
 		if (on_cv_trigger.process(inputs[ON_CV_INPUT].getVoltage())) {
-			if (!audition_mixer) {
+			if (!audition.active) {
 				auto_override = false;   // do not override automation
 				metro_fader.on = !metro_fader.on;
 			}
@@ -184,13 +236,9 @@ struct MetroCityBus : Module {
 		if (blue_post_trigger.process(params[BLUE_POST_PARAM].getValue())) post_fades[0] = !post_fades[0];
 		if (orange_post_trigger.process(params[ORANGE_POST_PARAM].getValue())) post_fades[1] = !post_fades[1];
 
-		if (light_divider.process()) {
-
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
-
-			if (audition_mixer) {   // all mixers are in audition state
+		// apply audition changes on the same frame as other mixers
+		if (audition_changed) {
+			if (audition.active) {   // all mixers are in audition state
 
 				// bypass all fade automation
 				auto_override = true;
@@ -221,6 +269,9 @@ struct MetroCityBus : Module {
 				// turn off auditions
 				auditioned = false;
 			}
+		}
+
+		if (light_divider.process()) {
 
 			// process fade speed changes if dragging slider
 			if (!auto_override) {
@@ -237,7 +288,7 @@ struct MetroCityBus : Module {
 
 			// set on light
 			if (metro_fader.getFade() == metro_fader.getGain()) {
-				if (audition_mixer) {
+				if (audition.active) {
 					lights[ON_LIGHT + 0].value = 1.f;   // yellow when auditioned
 					lights[ON_LIGHT + 1].value = 1.f;
 				} else {
@@ -284,6 +335,15 @@ struct MetroCityBus : Module {
 
 		// get number of channels
 		channel_no = inputs[POLY_INPUT].getChannels();
+		int blocks = (channel_no + 3) / 4;
+
+		// voice activity from envelopes, quiet voices count whether they are positive or negative
+		voice_activity = 0;
+		for (int b = 0; b < blocks; b++) {
+			simd::float_4 voices = inputs[POLY_INPUT].getVoltageSimd<simd::float_4>(b * 4);
+			voice_envelopes[b] = simd::fmax(simd::abs(voices), voice_envelopes[b] * envelope_decay);
+			voice_activity |= simd::movemask(voice_envelopes[b] > activity_threshold) << (b * 4);
+		}
 
 		// pans
 		if (pan_divider.process() && metro_fader.on) {   // calculate pan every few samples when input is on
@@ -291,61 +351,64 @@ struct MetroCityBus : Module {
 			// create follow pan when CV connected
 			if (inputs[PAN_CV_INPUT].isConnected()) {
 
+				following = true;
+
 				// get pan knob with CV and attenuator
 				float pan_pos = params[PAN_PARAM].getValue() + (((inputs[PAN_CV_INPUT].getNormalVoltage(0) * 2) * params[PAN_ATT_PARAM].getValue()) * 0.1f);
-				metro_pan[0].setSmoothPan(pan_pos);
-				light_pan[0] = metro_pan[0].position;   // pan position for lights
+				follow_pan.setSmoothPan(pan_pos);
+				light_pan[0] = follow_pan.position;   // pan position for lights
 
 				// spread is only 0 to 1 for pan follow
 				spread_pos = std::abs(params[SPREAD_PARAM].getValue());
+				follow_summing = (spread_pos == 0.f || channel_no < 2);
+
+				// Calculate delay for pan, fractional so follow delays glide with the spread knob
+				f_delay = spread_pos * pan_rate;
+
+				// Store pan history of first channel, the ring holds the longest follow at this spread and channel count
+				bool history_ready = pan_history.prepare((long)((channel_no - 1) * f_delay) + 1);
+				if (history_ready) pan_history.writePosition(follow_pan.position);
 
-				// Store pan history of first channel
-				if (hist_i >= HISTORY_CAP) hist_i = 0;   // reset history buffer index
-				pan_history[hist_i] = metro_pan[0].position;
-
-				// Calculate delay for pan
-				f_delay = std::round(spread_pos * pan_rate);   // f_delay * 16 should not be more than HISTORY_CAP
-
-				// calculate pan position for other channels
-				for (int c = 1; c < channel_no; c++) {
-					long follow = c * f_delay;
-					if (follow <= hist_size) {   // stay put until there is enough history to follow
-						follow = hist_i - follow;
-						if (follow < 0) follow = HISTORY_CAP + follow;   // fix follow when buffer resets to 0
-
-						// smooth pan for dynamic channels and history catch up
-						if (inputs[POLY_INPUT].getPolyVoltage(c) > 0.f) {
-							metro_pan[c].setSmoothPan(pan_history[follow]);   // full pan calculation if there is sound
-							light_pan[c] = metro_pan[c].position;
-						} else {
-							light_pan[c] = pan_history[follow];   // set only lights on silent channels
+				if (follow_summing) {
+					for (int c = 1; c < channel_no; c++) {
+						light_pan[c] = follow_pan.position;
+					}
+				} else {
+
+					// calculate pan position for other channels, interpolated reads need no smoothing
+					for (int c = 1; c < channel_no; c++) {
+						float follow = c * f_delay;
+						if (follow + 1.f < pan_history.recorded()) {   // stay put until there is enough history to follow
+							light_pan[c] = pan_history.readPosition(follow);
 						}
 					}
-				}
 
-				hist_i++;   // Keep history buffer rolling
-				if (hist_size < HISTORY_CAP) hist_size++;
+					// pan levels for all voices four at a time
+					alignas(16) float voice_pos[16] = {};
+					for (int c = 0; c < channel_no; c++) {
+						voice_pos[reverse_poly ? channel_no - 1 - c : c] = light_pan[c];   // reverses order of pan levels applied to channels
+					}
+					for (int b = 0; b < blocks; b++) {
+						if (!((voice_activity >> (b * 4)) & 0xF)) continue;   // skip silent voices
+						simd::float_4 block_levels[2];
+						constantPanLevels(simd::float_4::load(&voice_pos[b * 4]), block_levels);
+						follow_levels[0][b] = block_levels[0];
+						follow_levels[1][b] = block_levels[1];
+					}
+				}
 
 			} else {   // create spread pan when no CV connected
 
-				hist_size = 0; hist_i = 0;   // reset pan history when CV not connected
+				following = false;
 
-				// Get pan and spread positions
-				metro_pan[0].setPan(params[PAN_PARAM].getValue());   // first channel is pan knob position
-				light_pan[0] = metro_pan[0].position;   // pan position for lights
+				// hand pan history back to be freed when CV not connected
+				pan_history.release();
 
+				// spread is a portion of field between pan knob and hard left or hard right, levels are rebuilt only after changes
 				spread_pos = params[SPREAD_PARAM].getValue();
-
-				// Calculate spread as portion of field between pan knob and hard left or hard right
-				float pan_spread = 0.f;
-				if (spread_pos < 0) pan_spread = (metro_pan[0].position + 1) * spread_pos;
-				if (spread_pos > 0) pan_spread = -1 * ((metro_pan[0].position - 1) * spread_pos);
-
-				// calculate polyphonic spread and pan levels for other channels
-				for (int c = 1; c < channel_no; c++) {
-					float channel_pos = metro_pan[0].position + (((float)c / (float)(channel_no - 1)) * pan_spread);
-					metro_pan[c].setSmoothPan(channel_pos);
-					light_pan[c] = metro_pan[c].position;
+				spread_pan.setSpread(params[PAN_PARAM].getValue(), spread_pos, channel_no, reverse_poly, spread_pattern, spread_seed);
+				for (int c = 0; c < channel_no; c++) {
+					light_pan[c] = spread_pan.positions[c];   // pan positions for lights
 				}
 			}
 		}   // end pan_divider.process()
@@ -358,85 +421,130 @@ struct MetroCityBus : Module {
 			exp_fade = metro_fader.getFade();
 		}
 
-		// process inputs
-		float stereo_in[2] = {0.f, 0.f};
-		if (spread_pos == 0 && metro_pan[channel_no - 1].position == params[PAN_PARAM].getValue()) {   // sum channels if no spread
-			float sum_in = inputs[POLY_INPUT].getVoltageSum();
-			for (int c = 0; c < 2; c++) {
-				stereo_in[c] = sum_in * metro_pan[0].levels[c] * exp_fade;
+		// pan levels for each voice, spread levels slew after a change
+		spread_pan.slewLevels();
+		simd::float_4 (*mix_levels)[4] = following ? follow_levels : spread_pan.levels;
+		simd::float_4 summed_levels[2][4];
+		if (following && follow_summing) {
+			for (int b = 0; b < 4; b++) {
+				summed_levels[0][b] = follow_pan.levels[0];
+				summed_levels[1][b] = follow_pan.levels[1];
 			}
+			mix_levels = summed_levels;
+		}
+
+		// polyphonic level CV sets levels for each voice
+		bool poly_levels = false;
+		for (int sb = 0; sb < 3; sb++) {
+			if (inputs[LEVEL_CV_INPUTS + sb].getChannels() > 1) poly_levels = true;
+		}
+
+		float bus_sends[6];
+		if (poly_levels) {
+
+			// get voice levels, cv of mono cables is used for all voices
+			simd::float_4 voice_levels[3][4];
+			for (int sb = 0; sb < 3; sb++) {
+				float level_knob = params[LEVEL_PARAMS + sb].getValue();
+				for (int b = 0; b < blocks; b++) {
+					simd::float_4 level_cv = 1.f;
+					if (inputs[LEVEL_CV_INPUTS + sb].isConnected()) {
+						level_cv = simd::clamp(inputs[LEVEL_CV_INPUTS + sb].getPolyVoltageSimd<simd::float_4>(b * 4) * 0.1f, 0.f, 1.f);
+					}
+					voice_levels[sb][b] = level_cv * level_knob;
+					if (level_cv_filter) voice_levels[sb][b] = voice_level_smoothers[sb][b].slew(voice_levels[sb][b]);
+				}
+			}
+
+			// set post fades on voice levels
+			for (int i = 0; i < 2; i++) {
+				float post_amount = post_voice_filters[i].slew(post_fades[i] ? 1.f : 0.f);
+				for (int b = 0; b < blocks; b++) {
+					voice_levels[i][b] *= 1.f + (voice_levels[2][b] - 1.f) * post_amount;
+				}
+			}
+
+			// mix active voices to each bus
+			simd::float_4 send_sums[6] = {};
+			for (int b = 0; b < blocks; b++) {
+				if (!((voice_activity >> (b * 4)) & 0xF)) continue;   // skip silent voices
+				simd::float_4 voices = inputs[POLY_INPUT].getVoltageSimd<simd::float_4>(b * 4);
+				simd::float_4 panned[2] = {voices * mix_levels[0][b], voices * mix_levels[1][b]};
+				for (int sb = 0; sb < 3; sb++) {
+					send_sums[2 * sb] += panned[0] * voice_levels[sb][b];
+					send_sums[(2 * sb) + 1] += panned[1] * voice_levels[sb][b];
+				}
+			}
+			for (int i = 0; i < 6; i++) {
+				bus_sends[i] = (send_sums[i][0] + send_sums[i][1] + send_sums[i][2] + send_sums[i][3]) * exp_fade;
+			}
+
 		} else {
-			for (int c = 0; c < channel_no; c++) {
-				float channel_in = inputs[POLY_INPUT].getPolyVoltage(c);
-				if (reverse_poly) {   // reverses order of pan levels applied to channels
-					stereo_in[0] += channel_in * metro_pan[channel_no - c - 1].levels[0];
-					stereo_in[1] += channel_in * metro_pan[channel_no - c - 1].levels[1];
-				} else {
-					stereo_in[0] += channel_in * metro_pan[c].levels[0];
-					stereo_in[1] += channel_in * metro_pan[c].levels[1];
+
+			// process inputs
+			float stereo_in[2] = {0.f, 0.f};
+			if (!following) {
+				spread_pan.mix(inputs[POLY_INPUT], stereo_in, voice_activity);   // sums channels if no spread
+			} else if (follow_summing) {   // sum channels if no spread
+				float sum_in = inputs[POLY_INPUT].getVoltageSum();
+				for (int c = 0; c < 2; c++) {
+					stereo_in[c] = sum_in * follow_pan.levels[c];
+				}
+			} else {
+				simd::float_4 stereo_sums[2] = {};
+				for (int b = 0; b < blocks; b++) {
+					if (!((voice_activity >> (b * 4)) & 0xF)) continue;   // skip silent voices
+					simd::float_4 voices = inputs[POLY_INPUT].getVoltageSimd<simd::float_4>(b * 4);
+					stereo_sums[0] += voices * mix_levels[0][b];
+					stereo_sums[1] += voices * mix_levels[1][b];
+				}
+				for (int c = 0; c < 2; c++) {
+					stereo_in[c] = stereo_sums[c][0] + stereo_sums[c][1] + stereo_sums[c][2] + stereo_sums[c][3];
 				}
 			}
 
 			// Apply fade after summing
 			stereo_in[0] *= exp_fade;
 			stereo_in[1] *= exp_fade;
-		}
 
-		// process bus outputs
-		for (int sb = 0; sb < 3; sb++) {   // sb = stereo bus
-			for (int c = 0; c < 2; c++) {
-				int bus_channel = (2 * sb) + c;
-				outputs[BUS_OUTPUT].setVoltage((stereo_in[c] * in_levels[sb]) + inputs[BUS_INPUT].getPolyVoltage(bus_channel), bus_channel);
+			// get sends for 3 stereo buses
+			for (int sb = 0; sb < 3; sb++) {   // sb = stereo bus
+				for (int c = 0; c < 2; c++) {
+					bus_sends[(2 * sb) + c] = stereo_in[c] * in_levels[sb];
+				}
 			}
 		}
 
-		// set bus outputs for 3 stereo buses out
-		outputs[BUS_OUTPUT].setChannels(6);
+		// process bus outputs, sends go to the selected rig and the other rig passes through
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.addRig(bus_rig, bus_sends);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
 
-		// set lights
+		// snapshot voices for the pan lights, written to the frame the UI is not reading
 		if (pan_light_divider.process()) {   // set lights infrequently
-
+			int snapshot = light_snapshots.load(std::memory_order_relaxed) + 1;
+			PanLightSnapshot &light_frame = light_frames[snapshot & 1];
 			for (int c = 0; c < channel_no; c++) {
-				for (int l = 0; l < 9; l++) {
-					float light_pos = (l * light_delta) - 1 - (light_delta / 2.f);
-
-					// roll back lights when out of bounds
-					if (light_pan[c] > 1) {
-						light_pan[c] = 1.f - (light_pan[c] - 1.f);
-					} else {
-						if (light_pan[c] < -1) {
-							light_pan[c] = std::abs(light_pan[c] + 1.f) + -1.f;
-						}
-					}
-
-					// set initial pan light brightness
-					if (light_pan[c] >= light_pos && light_pan[c] < light_pos + light_delta) {
-						int flipper = c;   // used to flip lights when reverse channel button is on
-						if (reverse_poly) flipper = channel_no - 1 - c;   // channel flipping for reverse poly
-						if (inputs[POLY_INPUT].getVoltage(flipper) * 0.075f > light_brights[l]) {
-							light_brights[l] = inputs[POLY_INPUT].getVoltage(flipper) * 0.5f;
-						} else {
-							if (light_brights[l] < 0.15f) light_brights[l] = 0.15f;   // light visible for quiet channel
-						}
-					}
-				}   // for l lights
-			}   // for c channels
-
-			// process changes to pan light brightness
-			for (int l = 0; l < 9; l++) {
-				if (light_brights[l] > 0) {
-					lights[PAN_LIGHTS + l].value = light_brights[l];
-					light_brights[l] -= 1000 / args.sampleRate;
-				}
-			}
-
-			// turn off pan lights if input is off
-			if (metro_fader.getFade() == 0.f) {
-				for (int l = 0; l < 9; l++) lights[PAN_LIGHTS + l].value = 0;
+				int flipper = c;   // used to flip lights when reverse channel button is on
+				if (reverse_poly) flipper = channel_no - 1 - c;   // channel flipping for reverse poly
+				light_frame.pans[c].store(light_pan[c], std::memory_order_relaxed);
+				light_frame.volts[c].store(inputs[POLY_INPUT].getVoltage(flipper), std::memory_order_relaxed);
 			}
+			light_frame.channels.store(channel_no, std::memory_order_relaxed);
+			light_frame.on.store(metro_fader.getFade() != 0.f, std::memory_order_relaxed);
+			light_frame.decay.store(1000 / args.sampleRate, std::memory_order_relaxed);
+			light_snapshots.store(snapshot, std::memory_order_release);
 		}   // light divider
 	}
 
+	// pass the bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUT], outputs[BUS_OUTPUT]);
+	}
+
 	// save on, post and reverse buttons, and gain states
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
@@ -448,9 +556,15 @@ struct MetroCityBus : Module {
 		json_object_set_new(rootJ, "level_cv_filter", json_integer(level_cv_filter));
 		json_object_set_new(rootJ, "fade_in", json_real(fade_in));
 		json_object_set_new(rootJ, "fade_out", json_real(fade_out));
-		json_object_set_new(rootJ, "audition_mixer", json_integer(audition_mixer));
+		json_object_set_new(rootJ, "audition_mixer", json_integer(audition.isActive()));
+		json_object_set_new(rootJ, "audition_group", json_integer(audition.group));
 		json_object_set_new(rootJ, "auditioned", json_integer(auditioned));
 		json_object_set_new(rootJ, "temped", json_integer(metro_fader.temped));
+		json_object_set_new(rootJ, "pan_division", json_integer(requested_division.load()));
+		json_object_set_new(rootJ, "spread_pattern", json_integer(spread_pattern));
+		json_object_set_new(rootJ, "spread_seed", json_integer(spread_seed));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
 		return rootJ;
@@ -478,24 +592,37 @@ struct MetroCityBus : Module {
 		if (fade_inJ) fade_in = json_real_value(fade_inJ);
 		json_t *fade_outJ = json_object_get(rootJ, "fade_out");
 		if (fade_outJ) fade_out = json_real_value(fade_outJ);
+		json_t *audition_groupJ = json_object_get(rootJ, "audition_group");
+		if (audition_groupJ) audition.setGroup(json_integer_value(audition_groupJ));
 		json_t *audition_mixerJ = json_object_get(rootJ, "audition_mixer");
 		if (audition_mixerJ) {
-			audition_mixer = json_integer_value(audition_mixerJ);
+			audition.set(json_integer_value(audition_mixerJ), APP->engine->getFrame());
 		} else {
-			audition_mixer = false;   // no auditioning when loading old patch right after auditioned patch
+			audition.set(false, APP->engine->getFrame());   // no auditioning when loading old patch right after auditioned patch
 		}
 		json_t *auditionedJ = json_object_get(rootJ, "auditioned");
 		if (auditionedJ) auditioned = json_integer_value(auditionedJ);
 		json_t *tempedJ = json_object_get(rootJ, "temped");
 		if (tempedJ) metro_fader.temped = json_integer_value(tempedJ);
+		json_t *pan_divisionJ = json_object_get(rootJ, "pan_division");
+		if (pan_divisionJ) setPanDivision(json_integer_value(pan_divisionJ));
+		json_t *spread_patternJ = json_object_get(rootJ, "spread_pattern");
+		if (spread_patternJ) spread_pattern = json_integer_value(spread_patternJ);
+		json_t *spread_seedJ = json_object_get(rootJ, "spread_seed");
+		if (spread_seedJ) spread_seed = json_integer_value(spread_seedJ);
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
 		} else {
 			if (input_onJ) use_default_theme = false;   // do not change existing patches
 		}
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
 	}
 
 	// recalculate fader, pan smoothing, and pan_rate (used by pan follow)
@@ -505,16 +632,10 @@ struct MetroCityBus : Module {
 		} else {
 			metro_fader.setSpeed(fade_out);
 		}
-		for (int i = 0; i < 16; i++) {
-			metro_pan[i].setSmoothSpeed(smooth_speed);
-		}
-		pan_rate = (APP->engine->getSampleRate() / pan_division);   // used by pan follow, accounts for pan clock divider
-		for (int i = 0; i < 3; i++) {
-			level_smoother[i].setSlewSpeed(level_speed);
-		}
-		for (int i = 0; i < 2; i++) {
-			post_btn_filters[i].setSlewSpeed(level_speed);
-		}
+		follow_pan.setSmoothSpeed(smooth_speed);
+		spread_pan.setSlewSpeed(smooth_speed);
+		pan_rate = APP->engine->getSampleRate() / pan_division;   // used by pan follow, accounts for pan clock divider
+		setLevelSpeeds();
 	}
 
 	// Initialize on state and buttons
@@ -528,16 +649,58 @@ struct MetroCityBus : Module {
 		post_fades[1] = post_fades[0];
 		initializePanObjects();
 		level_cv_filter = true;
-		audition_mixer = false;
+		setPanDivision(3);
+		spread_pattern = SPREAD_LINEAR;
+		bus_rig = 0;
+		audition.set(false, APP->engine->getFrame());
+		audition.setGroup(0);
+		station_publisher.station = -1;
+	}
+
+	// level smoothing and voice activity speeds
+	void setLevelSpeeds() {
+		for (int i = 0; i < 3; i++) {
+			level_smoother[i].setSlewSpeed(level_speed);
+			for (int b = 0; b < 4; b++) {
+				voice_level_smoothers[i][b].setSlewSpeed(level_speed);
+			}
+		}
+		for (int i = 0; i < 2; i++) {
+			post_btn_filters[i].setSlewSpeed(level_speed);
+			post_voice_filters[i].setSlewSpeed(level_speed);
+		}
+		envelope_decay = std::exp(-1.f / (0.05f * APP->engine->getSampleRate()));   // voices are silent 50 ms after they stop
+	}
+
+	// pan follow history rate, safe from any thread
+	void setPanDivision(int division) {
+		requested_division.store(division, std::memory_order_relaxed);
+	}
+
+	// audio thread: change the pan rate, history at the old rate is dropped
+	void applyPanDivision(int division) {
+		pan_division = division;
+		pan_divider.setDivision(pan_division);
+		pan_rate = APP->engine->getSampleRate() / pan_division;
+		pan_history.reset();
+	}
+
+	// UI thread: update memory for the spread knob tooltip, pan history is sized on the ring thread without the UI
+	void updateMemoryBytes() {
+		history_bytes = pan_history.bytes();
+		memory_bytes = sizeof(MetroCityBus) + history_bytes;
 	}
 
 	// initialize pan objects
 	void initializePanObjects () {
-		for (int i = 0; i < 16; i++) {
-			metro_pan[i].position = 0.f;
-			metro_pan[i].levels[0] = 1.f;
-			metro_pan[i].levels[1] = 1.f;
-			metro_pan[i].setSmoothSpeed(smooth_speed);
+		follow_pan.position = 0.f;
+		follow_pan.levels[0] = 1.f;
+		follow_pan.levels[1] = 1.f;
+		follow_pan.setSmoothSpeed(smooth_speed);
+		spread_pan.setSlewSpeed(smooth_speed);
+		for (int b = 0; b < 4; b++) {
+			follow_levels[0][b] = 1.f;
+			follow_levels[1][b] = 1.f;
 		}
 	}
 
@@ -545,22 +708,14 @@ struct MetroCityBus : Module {
 
 
 struct MetroCityBusWidget : ModuleWidget {
-	SvgPanel* night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
+	float light_brights[9] = {};
+	int light_snapshots = 0;
 
 	MetroCityBusWidget(MetroCityBus *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MetroCityBus.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MetroCityBus_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("MetroCityBus", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
@@ -659,6 +814,68 @@ struct MetroCityBusWidget : ModuleWidget {
 			}
 		};
 
+		struct PanDivisionItem : MenuItem {
+			MetroCityBus *module;
+			int pan_division;
+			void onAction(const event::Action &e) override {
+				module->setPanDivision(pan_division);
+			}
+		};
+
+		struct PanDivisionsItem : MenuItem {
+			MetroCityBus *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string division_titles[4] = {"Every sample", "Every 3 samples (default)", "Every 6 samples", "Every 12 samples"};
+				int divisions[4] = {1, 3, 6, 12};
+				for (int i = 0; i < 4; i++) {
+					PanDivisionItem *division_item = new PanDivisionItem;
+					division_item->text = division_titles[i];
+					division_item->rightText = CHECKMARK(module->requested_division == divisions[i]);
+					division_item->module = module;
+					division_item->pan_division = divisions[i];
+					menu->addChild(division_item);
+				}
+				return menu;
+			}
+		};
+
+		struct SpreadPatternItem : MenuItem {
+			MetroCityBus *module;
+			int spread_pattern;
+			void onAction(const event::Action &e) override {
+				module->spread_pattern = spread_pattern;
+			}
+		};
+
+		struct SpreadSeedItem : MenuItem {
+			MetroCityBus *module;
+			void onAction(const event::Action &e) override {
+				module->spread_seed = random::u32();
+			}
+		};
+
+		struct SpreadPatternsItem : MenuItem {
+			MetroCityBus *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string pattern_titles[SPREAD_PATTERNS] = {"Linear (default)", "Alternate left and right", "Random", "Center out", "Clustered"};
+				for (int i = 0; i < SPREAD_PATTERNS; i++) {
+					SpreadPatternItem *pattern_item = new SpreadPatternItem;
+					pattern_item->text = pattern_titles[i];
+					pattern_item->rightText = CHECKMARK(module->spread_pattern == i);
+					pattern_item->module = module;
+					pattern_item->spread_pattern = i;
+					menu->addChild(pattern_item);
+				}
+				menu->addChild(new MenuEntry);
+				SpreadSeedItem *seed_item = createMenuItem<SpreadSeedItem>("New random spread");
+				seed_item->module = module;
+				menu->addChild(seed_item);
+				return menu;
+			}
+		};
+
 		// set post fader defaults on blue and orange buses
 		struct DefaultFadeItem : MenuItem {
 			MetroCityBus *module;
@@ -696,6 +913,7 @@ struct MetroCityBusWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -705,6 +923,7 @@ struct MetroCityBusWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -766,11 +985,36 @@ struct MetroCityBusWidget : ModuleWidget {
 		levelCvFiltersItem->module = module;
 		menu->addChild(levelCvFiltersItem);
 
+		SpreadPatternsItem *spreadPatternsItem = createMenuItem<SpreadPatternsItem>("Spread Pattern");
+		spreadPatternsItem->rightText = RIGHT_ARROW;
+		spreadPatternsItem->module = module;
+		menu->addChild(spreadPatternsItem);
+
+		PanDivisionsItem *panDivisionsItem = createMenuItem<PanDivisionsItem>("Pan Follow Rate");
+		panDivisionsItem->rightText = RIGHT_ARROW;
+		panDivisionsItem->module = module;
+		menu->addChild(panDivisionsItem);
+
 		PostFadesItem *postFadesItem = createMenuItem<PostFadesItem>("Blue and Orange Levels");
 		postFadesItem->rightText = RIGHT_ARROW;
 		postFadesItem->module = module;
 		menu->addChild(postFadesItem);
 
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		AuditionGroupsItem *auditionGroupsItem = createMenuItem<AuditionGroupsItem>("Audition Group");
+		auditionGroupsItem->rightText = RIGHT_ARROW;
+		auditionGroupsItem->audition = &(module->audition);
+		menu->addChild(auditionGroupsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
 #ifndef USING_CARDINAL_NOT_RACK
 		menu->addChild(new MenuEntry);
 
@@ -781,19 +1025,84 @@ struct MetroCityBusWidget : ModuleWidget {
 #endif
 	}
 
-	// display panel based on theme
+	// bin each voice of the latest snapshot to its pan light in one pass
+	void updatePanLights(MetroCityBus *module) {
+		int snapshots = module->light_snapshots.load(std::memory_order_acquire);
+		if (snapshots == light_snapshots) return;
+		int ticks = std::min(snapshots - light_snapshots, 64);   // snapshots since the last update
+		light_snapshots = snapshots;
+
+		// copy the snapshot once, so channels and voices agree through both passes
+		PanLightSnapshot &light_frame = module->light_frames[snapshots & 1];
+		int channels = math::clamp(light_frame.channels.load(std::memory_order_relaxed), 0, 16);
+		alignas(16) float light_pans[16] = {};
+		float light_volts[16];
+		for (int c = 0; c < channels; c++) {
+			light_pans[c] = light_frame.pans[c].load(std::memory_order_relaxed);
+			light_volts[c] = light_frame.volts[c].load(std::memory_order_relaxed);
+		}
+		bool lights_on = light_frame.on.load(std::memory_order_relaxed);
+		float light_decay = light_frame.decay.load(std::memory_order_relaxed);
+
+		const float light_delta = 2.f / 8.f;   // 8 divisions because light 1 and 9 are halved by offset
+		alignas(16) float bins[16];
+		alignas(16) float peaks[9];
+		for (int l = 0; l < 9; l++) peaks[l] = -INFINITY;
+
+		for (int b = 0; b < (channels + 3) / 4; b++) {
+			simd::float_4 pans = simd::float_4::load(&light_pans[b * 4]);
+
+			// roll back lights when out of bounds
+			pans = simd::ifelse(pans > 1.f, 2.f - pans, pans);
+			pans = simd::ifelse(pans < -1.f, -2.f - pans, pans);
+
+			simd::float_4 light_bins = simd::floor((pans + 1.f + light_delta * 0.5f) * (1.f / light_delta));
+			simd::clamp(light_bins, 0.f, 8.f).store(&bins[b * 4]);
+		}
+		for (int c = 0; c < channels; c++) {
+			int l = (int)bins[c];
+			peaks[l] = std::fmax(peaks[l], light_volts[c]);
+		}
+
+		for (int l = 0; l < 9; l++) {
+
+			// set pan light brightness for lights with voices
+			if (peaks[l] != -INFINITY) {
+				if (peaks[l] * 0.075f > light_brights[l]) {
+					light_brights[l] = peaks[l] * 0.5f;
+				} else {
+					if (light_brights[l] < 0.15f) light_brights[l] = 0.15f;   // light visible for quiet channel
+				}
+			}
+
+			// process changes to pan light brightness
+			if (light_brights[l] > 0) {
+				module->lights[MetroCityBus::PAN_LIGHTS + l].value = light_brights[l];
+				light_brights[l] -= light_decay * ticks;
+			}
+
+			// turn off pan lights if input is off
+			if (!lights_on) module->lights[MetroCityBus::PAN_LIGHTS + l].value = 0;
+		}
+	}
+
+	// display panel and components when the theme changes
 	void step() override {
-#ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
 		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((MetroCityBus*)module)->color_theme) == 0);
-			night_panel->visible = ((((MetroCityBus*)module)->color_theme) == 1);
+			((MetroCityBus*)module)->updateMemoryBytes();
+			updatePanLights((MetroCityBus*)module);
 		}
+#ifdef USING_CARDINAL_NOT_RACK
+		showGtgNightPanel(this, night_panel, "MetroCityBus", settings::darkMode);
 #endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			MetroCityBus *themed_module = (MetroCityBus*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "MetroCityBus", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
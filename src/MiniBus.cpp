@@ -1,6 +1,8 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
 #include "gtgDSP.hpp"
+#include "gtgAudition.hpp"
+#include "gtgStations.hpp"
 
 
 struct MiniBus : Module {
@@ -37,6 +39,9 @@ struct MiniBus : Module {
 	bool auto_override = false;
 	bool post_fades = false;
 	bool auditioned = false;
+	AuditionFollower audition{mixer_auditions};
+	int bus_rig = 0;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
@@ -61,14 +66,17 @@ struct MiniBus : Module {
 
 	void process(const ProcessArgs &args) override {
 
+		// audition changes apply on the same frame in every mixer of the audition group
+		bool audition_changed = audition.process(args.frame);
+
 		// on off button
 		switch (on_button.step(params[ON_PARAM])) {
 		default:
 		case LongPressButton::NO_PRESS:
 			break;
 		case LongPressButton::SHORT_PRESS:
-			if (audition_mixer) {
-				audition_mixer = false;   // single click turns off auditions
+			if (audition.active) {
+				audition.set(false, args.frame);   // single click turns off auditions
 			} else {
 				if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL) {   // bypass fades with ctrl click
 					auto_override = true;
@@ -94,7 +102,7 @@ struct MiniBus : Module {
 			break;
 		case LongPressButton::LONG_PRESS:   // long press to audition
 
-			audition_mixer = true;   // all mixers to audition mode
+			audition.set(true, args.frame);   // all mixers to audition mode
 
 			if (auditioned) {
 				auditioned = false;
@@ -114,7 +122,7 @@ struct MiniBus : Module {
 
 		// process cv trigger
 		if (on_cv_trigger.process(inputs[ON_CV_INPUT].getVoltage())) {
-			if (!audition_mixer) {
+			if (!audition.active) {
 				auto_override = false;   // do not override automation
 				mini_fader.on = !mini_fader.on;
 			}
@@ -122,14 +130,9 @@ struct MiniBus : Module {
 
 		mini_fader.process();
 
-		// process fade states, light, and default theme
-		if (light_divider.process()) {
-
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
-
-			if (audition_mixer) {   // all mixers are in audition state
+		// apply audition changes on the same frame as other mixers
+		if (audition_changed) {
+			if (audition.active) {   // all mixers are in audition state
 
 				// bypass all fade automation
 				auto_override = true;
@@ -160,6 +163,10 @@ struct MiniBus : Module {
 				// turn off auditions
 				auditioned = false;
 			}
+		}
+
+		// process fade states, light, and default theme
+		if (light_divider.process()) {
 
 			// process fade speed changes if dragging slider
 			if (!auto_override) {
@@ -176,7 +183,7 @@ struct MiniBus : Module {
 
 			// set lights
 			if (mini_fader.getFade() == mini_fader.getGain()) {
-				if (audition_mixer) {
+				if (audition.active) {
 					lights[ON_LIGHT + 0].value = 1.f;   // yellow when auditioned
 					lights[ON_LIGHT + 1].value = 1.f;
 				} else {
@@ -225,16 +232,25 @@ struct MiniBus : Module {
 			bus_outs[sb] = mono_in * in_levels[sb];
 		}
 
-		// step through all outputs
-		outputs[BUS_OUTPUT].setVoltage(bus_outs[0] + inputs[BUS_INPUT].getPolyVoltage(0), 0);
-		outputs[BUS_OUTPUT].setVoltage(bus_outs[0] + inputs[BUS_INPUT].getPolyVoltage(1), 1);
-		outputs[BUS_OUTPUT].setVoltage(bus_outs[1] + inputs[BUS_INPUT].getPolyVoltage(2), 2);
-		outputs[BUS_OUTPUT].setVoltage(bus_outs[1] + inputs[BUS_INPUT].getPolyVoltage(3), 3);
-		outputs[BUS_OUTPUT].setVoltage(bus_outs[2] + inputs[BUS_INPUT].getPolyVoltage(4), 4);
-		outputs[BUS_OUTPUT].setVoltage(bus_outs[2] + inputs[BUS_INPUT].getPolyVoltage(5), 5);
+		// split mono to both sides of each stereo bus
+		float bus_sends[6];
+		for (int sb = 0; sb < 3; sb++) {
+			bus_sends[(2 * sb) + 0] = bus_outs[sb];
+			bus_sends[(2 * sb) + 1] = bus_outs[sb];
+		}
 
-		// always set bus outputs for 3 stereo buses out
-		outputs[BUS_OUTPUT].setChannels(6);
+		// step through all outputs, sends go to the selected rig and the other rig passes through
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.addRig(bus_rig, bus_sends);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
+	}
+
+	// pass the bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUT], outputs[BUS_OUTPUT]);
 	}
 
 	// save on button, gain states, and color theme
@@ -245,9 +261,12 @@ struct MiniBus : Module {
 		json_object_set_new(rootJ, "gain", json_real(mini_fader.getGain()));
 		json_object_set_new(rootJ, "fade_in", json_real(fade_in));
 		json_object_set_new(rootJ, "fade_out", json_real(fade_out));
-		json_object_set_new(rootJ, "audition_mixer", json_integer(audition_mixer));
+		json_object_set_new(rootJ, "audition_mixer", json_integer(audition.isActive()));
+		json_object_set_new(rootJ, "audition_group", json_integer(audition.group));
 		json_object_set_new(rootJ, "auditioned", json_integer(auditioned));
 		json_object_set_new(rootJ, "temped", json_integer(mini_fader.temped));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
 		return rootJ;
@@ -269,24 +288,31 @@ struct MiniBus : Module {
 		if (fade_inJ) fade_in = json_real_value(fade_inJ);
 		json_t *fade_outJ = json_object_get(rootJ, "fade_out");
 		if (fade_outJ) fade_out = json_real_value(fade_outJ);
+		json_t *audition_groupJ = json_object_get(rootJ, "audition_group");
+		if (audition_groupJ) audition.setGroup(json_integer_value(audition_groupJ));
 		json_t *audition_mixerJ = json_object_get(rootJ, "audition_mixer");
 		if (audition_mixerJ) {
-			audition_mixer = json_integer_value(audition_mixerJ);
+			audition.set(json_integer_value(audition_mixerJ), APP->engine->getFrame());
 		} else {
-			audition_mixer = false;   // no auditioning when loading old patch right after auditioned patch
+			audition.set(false, APP->engine->getFrame());   // no auditioning when loading old patch right after auditioned patch
 		}
 		json_t *auditionedJ = json_object_get(rootJ, "auditioned");
 		if (auditionedJ) auditioned = json_integer_value(auditionedJ);
 		json_t *tempedJ = json_object_get(rootJ, "temped");
 		if (tempedJ) mini_fader.temped = json_integer_value(tempedJ);
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
 		} else {
 			if (input_onJ) use_default_theme = false;   // do not change existing patches
 		}
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
 	}
 
 	// reset fader speed
@@ -306,28 +332,21 @@ struct MiniBus : Module {
 		fade_in = 26.f;
 		fade_out = 26.f;
 		post_fades = loadGtgPluginDefault("default_post_fader", 0);
-		audition_mixer = false;
+		bus_rig = 0;
+		audition.set(false, APP->engine->getFrame());
+		audition.setGroup(0);
+		station_publisher.station = -1;
 	}
 };
 
 
 struct MiniBusWidget : ModuleWidget {
-	SvgPanel *night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	MiniBusWidget(MiniBus *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MiniBus.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MiniBus_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("MiniBus", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
@@ -432,6 +451,7 @@ struct MiniBusWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -441,6 +461,7 @@ struct MiniBusWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -502,6 +523,21 @@ struct MiniBusWidget : ModuleWidget {
 		postFadesItem->module = module;
 		menu->addChild(postFadesItem);
 
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		AuditionGroupsItem *auditionGroupsItem = createMenuItem<AuditionGroupsItem>("Audition Group");
+		auditionGroupsItem->rightText = RIGHT_ARROW;
+		auditionGroupsItem->audition = &(module->audition);
+		menu->addChild(auditionGroupsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
 #ifndef USING_CARDINAL_NOT_RACK
 		menu->addChild(new MenuEntry);
 
@@ -512,19 +548,19 @@ struct MiniBusWidget : ModuleWidget {
 #endif
 	}
 
-	// display panel based on theme
+	// display panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((MiniBus*)module)->color_theme) == 0);
-			night_panel->visible = ((((MiniBus*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "MiniBus", settings::darkMode);
 #endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			MiniBus *themed_module = (MiniBus*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "MiniBus", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
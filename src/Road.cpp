@@ -1,6 +1,7 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
 #include "gtgDSP.hpp"
+#include "gtgStations.hpp"
 
 struct Road : Module {
 	enum ParamIds {
@@ -27,6 +28,8 @@ struct Road : Module {
 	const int fade_speed = 26;
 	bool bus_audition[6] = {false, false, false, false, false, false};
 	bool auditioning = false;
+	int rig_mode = 0;   // 0 merges both rigs, 1 and 2 demux rig A or rig B to channels 1-6
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
@@ -93,10 +96,6 @@ struct Road : Module {
 
 		if (light_divider.process()) {
 
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
-
 			if (auditioning) {
 				for (int i = 0; i < 6; i++) {
 					if (bus_audition[i]) {
@@ -146,24 +145,38 @@ struct Road : Module {
 
 		}   // end light_divider.process()
 
-		// sum channels from connected buses
-		float bus_sum[6] = {};
+		// sum channels of both rigs from connected buses
+		BusFrame bus_sum;
+		int bus_channels = RIG_CHANNELS;
 
 		for (int b = 0; b < 6; b++) {
 			if (inputs[BUS_INPUTS + b].isConnected()) {
-				for (int c = 0; c < 6; c++) {
-					bus_sum[c] += inputs[BUS_INPUTS + b].getPolyVoltage(c) * road_fader[b].getFade();
+				BusFrame bus_in;
+				bus_in.load(inputs[BUS_INPUTS + b]);
+				for (int i = 0; i < 3; i++) {
+					bus_sum.v[i] += bus_in.v[i] * road_fader[b].getFade();
 				}
+				if (inputs[BUS_INPUTS + b].getChannels() > RIG_CHANNELS) bus_channels = DUAL_RIG_CHANNELS;
 			}
 		}
 
-		// set output bus to summed channels
-		for (int c = 0; c < 6; c++) {
-			outputs[BUS_OUTPUT].setVoltage(bus_sum[c], c);
+		// set output bus to summed channels, or to one rig as 3 stereo buses
+		if (rig_mode == 0) {
+			bus_sum.store(outputs[BUS_OUTPUT], bus_channels);
+			station_publisher.publish(args.frame, bus_sum, bus_channels);
+		} else {
+			float rig_sum[6];
+			bus_sum.getRig(rig_mode - 1, rig_sum);
+			BusFrame rig_out;
+			rig_out.setRig(0, rig_sum);
+			rig_out.store(outputs[BUS_OUTPUT], RIG_CHANNELS);
+			station_publisher.publish(args.frame, rig_out, RIG_CHANNELS);
 		}
+	}
 
-		// set output to 3 stereo buses
-		outputs[BUS_OUTPUT].setChannels(6);
+	// pass the first bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUTS + 0], outputs[BUS_OUTPUT]);
 	}
 
 	// save color theme
@@ -188,6 +201,8 @@ struct Road : Module {
 		json_object_set_new(rootJ, "temped4", json_integer(road_fader[3].temped));
 		json_object_set_new(rootJ, "temped5", json_integer(road_fader[4].temped));
 		json_object_set_new(rootJ, "temped6", json_integer(road_fader[5].temped));
+		json_object_set_new(rootJ, "rig_mode", json_integer(rig_mode));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
 		return rootJ;
@@ -237,14 +252,20 @@ struct Road : Module {
 		json_t *temped6j = json_object_get(rootJ, "temped6");
 		if (temped6j) road_fader[5].temped = json_integer_value(temped6j);
 
+		json_t *rig_modeJ = json_object_get(rootJ, "rig_mode");
+		if (rig_modeJ) rig_mode = json_integer_value(rig_modeJ);
+
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
 		} else {
 			if (onau_1J) use_default_theme = false;   // do not change existing patches
 		}
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
 	}
 
 	// reset fader speed
@@ -261,27 +282,19 @@ struct Road : Module {
 			bus_audition[i] = false;
 			road_fader[i].on = true;
 		}
+		rig_mode = 0;
+		station_publisher.station = -1;
 	}
 };
 
 
 struct RoadWidget : ModuleWidget {
-	SvgPanel* night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	RoadWidget(Road *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/Road.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/Road_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("Road", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
@@ -311,11 +324,35 @@ struct RoadWidget : ModuleWidget {
 		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(7.62, 114.107)), false, module, Road::BUS_OUTPUT, module ? &module->color_theme : NULL));
 	}
 
-#ifndef USING_CARDINAL_NOT_RACK
 	// build the menu
 	void appendContextMenu(Menu* menu) override {
 		Road* module = dynamic_cast<Road*>(this->module);
 
+		struct RigModeItem : MenuItem {
+			Road *module;
+			int rig_mode;
+			void onAction(const event::Action &e) override {
+				module->rig_mode = rig_mode;
+			}
+		};
+
+		struct RigModesItem : MenuItem {
+			Road *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string mode_titles[3] = {"Merge both rigs (default)", "Demux rig A to channels 1-6", "Demux rig B to channels 1-6"};
+				for (int i = 0; i < 3; i++) {
+					RigModeItem *rig_mode_item = new RigModeItem;
+					rig_mode_item->text = mode_titles[i];
+					rig_mode_item->rightText = CHECKMARK(module->rig_mode == i);
+					rig_mode_item->module = module;
+					rig_mode_item->rig_mode = i;
+					menu->addChild(rig_mode_item);
+				}
+				return menu;
+			}
+		};
+
 		struct ThemeItem : MenuItem {
 			Road* module;
 			int theme;
@@ -327,6 +364,7 @@ struct RoadWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -336,6 +374,7 @@ struct RoadWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -375,26 +414,39 @@ struct RoadWidget : ModuleWidget {
 
 		menu->addChild(new MenuEntry);
 
+		RigModesItem *rigModesItem = createMenuItem<RigModesItem>("Bus Rigs");
+		rigModesItem->rightText = RIGHT_ARROW;
+		rigModesItem->module = module;
+		menu->addChild(rigModesItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
+#ifndef USING_CARDINAL_NOT_RACK
+		menu->addChild(new MenuEntry);
+
 		ThemesItem *themesItem = createMenuItem<ThemesItem>("Panel Themes");
 		themesItem->rightText = RIGHT_ARROW;
 		themesItem->module = module;
 		menu->addChild(themesItem);
-	}
 #endif
+	}
 
-	// display the panel based on the theme
+	// display the panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((Road*)module)->color_theme) == 0);
-			night_panel->visible = ((((Road*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "Road", settings::darkMode);
+#endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			Road *themed_module = (Road*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "Road", themed_module->color_theme == 1);
 #endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
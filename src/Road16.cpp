@@ -0,0 +1,416 @@
+#include "plugin.hpp"
+#include "gtgComponents.hpp"
+#include "gtgDSP.hpp"
+#include "gtgStations.hpp"
+
+const int ROAD16_INPUTS = 16;
+
+struct Road16 : Module {
+	enum ParamIds {
+		ENUMS(ON_PARAMS, 16),
+		NUM_PARAMS
+	};
+	enum InputIds {
+		ENUMS(BUS_INPUTS, 16),
+		NUM_INPUTS
+	};
+	enum OutputIds {
+		BUS_OUTPUT,
+		NUM_OUTPUTS
+	};
+	enum LightIds {
+		ENUMS(ONAU_LIGHTS, 32),
+		NUM_LIGHTS
+	};
+
+	LongPressButton onauButtons[16];
+	dsp::ClockDivider light_divider;
+	dsp::ClockDivider channel_divider;
+	AutoFader road_fader[16];
+
+	const int fade_speed = 26;
+	bool bus_audition[16] = {};
+	bool auditioning = false;
+	int connected_mask = 0;   // one bit for each connected bus input, refreshed when cables change
+	int bus_channels = RIG_CHANNELS;
+	int rig_mode = 0;   // 0 merges both rigs, 1 and 2 demux rig A or rig B to channels 1-6
+	StationPublisher station_publisher;
+	int color_theme = 0;
+	bool use_default_theme = true;
+
+	Road16() {
+		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			configParam(ON_PARAMS + i, 0.f, 1.f, 0.f, string::f("BUS IN %d on", i + 1));
+			configInput(BUS_INPUTS + i, string::f("Bus chain %d", i + 1));
+		}
+		configOutput(BUS_OUTPUT, "Mixed bus chain");
+		light_divider.setDivision(512);
+		channel_divider.setDivision(32);
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			road_fader[i].setSpeed(fade_speed);
+		}
+		gtg_default_theme = loadGtgPluginDefault("default_theme", 0);
+		color_theme = gtg_default_theme;
+	}
+
+	void process(const ProcessArgs &args) override {
+
+		// get button presses
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			switch (onauButtons[i].step(params[ON_PARAMS + i])) {
+			default:
+			case LongPressButton::NO_PRESS:
+				break;
+			case LongPressButton::SHORT_PRESS:
+				if (auditioning) {
+					auditioning = false;
+				} else {
+					road_fader[i].on = !road_fader[i].on;
+				}
+				break;
+			case LongPressButton::LONG_PRESS:
+				auditioning = true;
+
+				if (bus_audition[i]) {
+					bus_audition[i] = false;
+					if (road_fader[i].temped) {
+						road_fader[i].on = false;
+						road_fader[i].temped = false;
+					}
+				} else {
+
+					bus_audition[i] = true;
+
+					if (!road_fader[i].on) {
+						road_fader[i].temped = !road_fader[i].temped;   // remember if bus was off
+					}
+				}
+				break;
+			}
+
+			road_fader[i].process();
+		}
+
+		// channel counts of connected cables can change without a port event
+		if (channel_divider.process()) updateConnections();
+
+		if (light_divider.process()) {
+
+			if (auditioning) {
+				for (int i = 0; i < ROAD16_INPUTS; i++) {
+					if (bus_audition[i]) {
+						road_fader[i].on = true;
+					} else {
+						if (road_fader[i].on) {
+							road_fader[i].temped = true;   // remember this fader was on
+						}
+						road_fader[i].on = false;
+					}
+				}
+			} else {
+				for (int i = 0; i < ROAD16_INPUTS; i++) {
+					if (road_fader[i].temped) {
+						road_fader[i].temped = false;
+						if (bus_audition[i]) {
+							road_fader[i].on = false;
+						} else {
+							road_fader[i].on = true;
+						}
+					}
+
+					bus_audition[i] = false;
+				}
+			}
+
+			// set lights
+			for (int i = 0; i < ROAD16_INPUTS; i++) {
+				if (road_fader[i].on) {
+					if (bus_audition[i]) {
+						lights[ONAU_LIGHTS + (i * 2)].value = 1.f;   // yellow when auditioned
+						lights[ONAU_LIGHTS + (i * 2) + 1].value = 1.f;
+					} else {
+						lights[ONAU_LIGHTS + (i * 2)].value = 1.f;   // green when on
+						lights[ONAU_LIGHTS + (i * 2) + 1].value = 0.f;
+					}
+				} else {
+					if (road_fader[i].temped) {
+						lights[ONAU_LIGHTS + (i * 2)].value = 0.f;   // red when muted
+						lights[ONAU_LIGHTS + (i * 2) + 1].value = 1.f;
+					} else {
+						lights[ONAU_LIGHTS + (i * 2)].value = 0.f;   // off
+						lights[ONAU_LIGHTS + (i * 2) + 1].value = 0.f;
+					}
+				}
+			}
+
+		}   // end light_divider.process()
+
+		// sum channels of both rigs from connected buses
+		BusFrame bus_sum;
+
+		for (int mask = connected_mask; mask; mask &= mask - 1) {   // only visit connected inputs
+			int b = __builtin_ctz(mask);
+			BusFrame bus_in;
+			bus_in.load(inputs[BUS_INPUTS + b]);
+			simd::float_4 fade = road_fader[b].getFade();
+			for (int i = 0; i < 3; i++) {
+				bus_sum.v[i] += bus_in.v[i] * fade;
+			}
+		}
+
+		// set output bus to summed channels, or to one rig as 3 stereo buses
+		if (rig_mode == 0) {
+			bus_sum.store(outputs[BUS_OUTPUT], bus_channels);
+			station_publisher.publish(args.frame, bus_sum, bus_channels);
+		} else {
+			float rig_sum[6];
+			bus_sum.getRig(rig_mode - 1, rig_sum);
+			BusFrame rig_out;
+			rig_out.setRig(0, rig_sum);
+			rig_out.store(outputs[BUS_OUTPUT], RIG_CHANNELS);
+			station_publisher.publish(args.frame, rig_out, RIG_CHANNELS);
+		}
+	}
+
+	// pass the first bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUTS + 0], outputs[BUS_OUTPUT]);
+	}
+
+	// save on, audition, and color theme states
+	// cache connected inputs and the widest bus cable
+	void updateConnections() {
+		connected_mask = 0;
+		bus_channels = RIG_CHANNELS;
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			if (inputs[BUS_INPUTS + i].isConnected()) {
+				connected_mask |= 1 << i;
+				if (inputs[BUS_INPUTS + i].getChannels() > RIG_CHANNELS) bus_channels = DUAL_RIG_CHANNELS;
+			}
+		}
+	}
+
+	void onAdd() override {
+		updateConnections();
+	}
+
+	void onPortChange(const PortChangeEvent &e) override {
+		updateConnections();
+	}
+
+	json_t *dataToJson() override {
+		json_t *rootJ = json_object();
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			json_object_set_new(rootJ, string::f("onau_%d", i + 1).c_str(), json_integer(road_fader[i].on));
+			json_object_set_new(rootJ, string::f("bus_audition%d", i + 1).c_str(), json_integer(bus_audition[i]));
+			json_object_set_new(rootJ, string::f("temped%d", i + 1).c_str(), json_integer(road_fader[i].temped));
+		}
+		json_object_set_new(rootJ, "auditioning", json_integer(auditioning));
+		json_object_set_new(rootJ, "rig_mode", json_integer(rig_mode));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
+		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
+		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
+		return rootJ;
+	}
+
+	// load on, audition, and color theme states
+	void dataFromJson(json_t *rootJ) override {
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			json_t *onauJ = json_object_get(rootJ, string::f("onau_%d", i + 1).c_str());
+			if (onauJ) road_fader[i].on = json_integer_value(onauJ);
+			json_t *bus_auditionJ = json_object_get(rootJ, string::f("bus_audition%d", i + 1).c_str());
+			if (bus_auditionJ) bus_audition[i] = json_integer_value(bus_auditionJ);
+			json_t *tempedJ = json_object_get(rootJ, string::f("temped%d", i + 1).c_str());
+			if (tempedJ) road_fader[i].temped = json_integer_value(tempedJ);
+		}
+
+		json_t *auditioningJ = json_object_get(rootJ, "auditioning");
+		if (auditioningJ) auditioning = json_integer_value(auditioningJ);
+
+		json_t *rig_modeJ = json_object_get(rootJ, "rig_mode");
+		if (rig_modeJ) rig_mode = json_integer_value(rig_modeJ);
+
+		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
+		if (use_default_themeJ) use_default_theme = json_integer_value(use_default_themeJ);
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
+		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
+		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
+	}
+
+	// reset fader speed
+	void onSampleRateChange() override {
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			road_fader[i].setSpeed(fade_speed);
+		}
+	}
+
+	// reset on audition states when initialized
+	void onReset() override {
+		auditioning = false;
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			bus_audition[i] = false;
+			road_fader[i].on = true;
+		}
+		rig_mode = 0;
+		station_publisher.station = -1;
+	}
+};
+
+
+struct Road16Widget : ModuleWidget {
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
+
+	Road16Widget(Road16 *module) {
+		setModule(module);
+		setPanel(loadGtgPanelSvg("Road16", 0));
+
+		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
+		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
+		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
+		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH), module ? &module->color_theme : NULL));
+
+		// two columns of eight bus inputs with on buttons
+		for (int i = 0; i < ROAD16_INPUTS; i++) {
+			float x = 6.12 + ((i / 8) * 15.24);
+			float y = 15.0 + ((i % 8) * 11.5);
+			addInput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(x, y)), true, module, Road16::BUS_INPUTS + i, module ? &module->color_theme : NULL));
+			addParam(createThemedParamCentered<gtgBlackTinyButton>(mm2px(Vec(x + 6.0, y + 4.5)), module, Road16::ON_PARAMS + i, module ? &module->color_theme : NULL));
+			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x + 6.0, y + 4.5)), module, Road16::ONAU_LIGHTS + (i * 2)));
+		}
+
+		addOutput(createThemedPortCentered<gtgNutPort>(mm2px(Vec(15.24, 114.107)), false, module, Road16::BUS_OUTPUT, module ? &module->color_theme : NULL));
+	}
+
+	// build the menu
+	void appendContextMenu(Menu* menu) override {
+		Road16* module = dynamic_cast<Road16*>(this->module);
+
+		struct RigModeItem : MenuItem {
+			Road16 *module;
+			int rig_mode;
+			void onAction(const event::Action &e) override {
+				module->rig_mode = rig_mode;
+			}
+		};
+
+		struct RigModesItem : MenuItem {
+			Road16 *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string mode_titles[3] = {"Merge both rigs (default)", "Demux rig A to channels 1-6", "Demux rig B to channels 1-6"};
+				for (int i = 0; i < 3; i++) {
+					RigModeItem *rig_mode_item = new RigModeItem;
+					rig_mode_item->text = mode_titles[i];
+					rig_mode_item->rightText = CHECKMARK(module->rig_mode == i);
+					rig_mode_item->module = module;
+					rig_mode_item->rig_mode = i;
+					menu->addChild(rig_mode_item);
+				}
+				return menu;
+			}
+		};
+
+		struct ThemeItem : MenuItem {
+			Road16* module;
+			int theme;
+			void onAction(const event::Action& e) override {
+				if (theme == 10) {
+					module->use_default_theme = true;
+					module->color_theme = gtg_default_theme;
+				} else {
+					module->use_default_theme = false;
+					module->color_theme = theme;
+				}
+				notifyGtgThemeChange();
+			}
+		};
+
+		struct DefaultThemeItem : MenuItem {
+			Road16* module;
+			int theme;
+			void onAction(const event::Action &e) override {
+				gtg_default_theme = theme;
+				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
+			}
+		};
+
+		struct ThemesItem : MenuItem {
+			Road16 *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::string theme_titles[3] = {"Default", "70's Cream", "Night Ride"};
+				int theme_selected[3] = {10, 0, 1};
+				for (int i = 0; i < 3; i++) {
+					ThemeItem *theme_item = new ThemeItem;
+					theme_item->text = theme_titles[i];
+					if (i == 0) {
+						theme_item->rightText = CHECKMARK(module->use_default_theme);
+					} else {
+						if (!module->use_default_theme) {
+							theme_item->rightText = CHECKMARK(module->color_theme == theme_selected[i]);
+						}
+					}
+					theme_item->module = module;
+					theme_item->theme = theme_selected[i];
+					menu->addChild(theme_item);
+				}
+		        menu->addChild(new MenuEntry);
+				std::string default_theme_titles[2] = {"Default to 70's Cream", "Default to Night Ride"};
+				for (int i = 0; i < 2; i++) {
+					DefaultThemeItem *default_theme_item = new DefaultThemeItem;
+					default_theme_item->text = default_theme_titles[i];
+					default_theme_item->rightText = CHECKMARK(gtg_default_theme == i);
+					default_theme_item->module = module;
+					default_theme_item->theme = i;
+					menu->addChild(default_theme_item);
+				}
+				return menu;
+			}
+		};
+
+		menu->addChild(new MenuEntry);
+
+		RigModesItem *rigModesItem = createMenuItem<RigModesItem>("Bus Rigs");
+		rigModesItem->rightText = RIGHT_ARROW;
+		rigModesItem->module = module;
+		menu->addChild(rigModesItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
+#ifndef USING_CARDINAL_NOT_RACK
+		menu->addChild(new MenuEntry);
+
+		ThemesItem *themesItem = createMenuItem<ThemesItem>("Panel Themes");
+		themesItem->rightText = RIGHT_ARROW;
+		themesItem->module = module;
+		menu->addChild(themesItem);
+#endif
+	}
+
+	// display the panel and components when the theme changes
+	void step() override {
+#ifdef USING_CARDINAL_NOT_RACK
+		showGtgNightPanel(this, night_panel, "Road16", settings::darkMode);
+#endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			Road16 *themed_module = (Road16*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "Road16", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
+		Widget::step();
+	}
+};
+
+
+Model *modelRoad16 = createModel<Road16, Road16Widget>("Road16");
@@ -1,6 +1,8 @@
 #include "plugin.hpp"
 #include "gtgComponents.hpp"
 #include "gtgDSP.hpp"
+#include "gtgAudition.hpp"
+#include "gtgStations.hpp"
 
 
 struct SchoolBus : Module {
@@ -51,9 +53,12 @@ struct SchoolBus : Module {
 	float fade_out = 26.f;
 	bool auto_override = false;
 	bool auditioned = false;
+	AuditionFollower audition{mixer_auditions};
 	bool post_fades[2] = {false, false};
 	bool pan_cv_filter = true;
 	bool level_cv_filter = true;
+	int bus_rig = 0;
+	StationPublisher station_publisher;
 	int color_theme = 0;
 	bool use_default_theme = true;
 
@@ -95,14 +100,17 @@ struct SchoolBus : Module {
 
 	void process(const ProcessArgs &args) override {
 
+		// audition changes apply on the same frame in every mixer of the audition group
+		bool audition_changed = audition.process(args.frame);
+
 		// on off button
 		switch (on_button.step(params[ON_PARAM])) {
 		default:
 		case LongPressButton::NO_PRESS:
 			break;
 		case LongPressButton::SHORT_PRESS:
-			if (audition_mixer) {
-				audition_mixer = false;   // single click turns off auditions
+			if (audition.active) {
+				audition.set(false, args.frame);   // single click turns off auditions
 			} else {
 				if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL) {   // bypass fades with ctrl click
 					auto_override = true;
@@ -128,7 +136,7 @@ struct SchoolBus : Module {
 			break;
 		case LongPressButton::LONG_PRESS:   // long press to audition
 
-			audition_mixer = true;   // all mixers to audition mode
+			audition.set(true, args.frame);   // all mixers to audition mode
 
 			if (auditioned) {
 				auditioned = false;
@@ -149,7 +157,7 @@ struct SchoolBus : Module {
 
 		// process cv trigger
 		if (on_cv_trigger.process(inputs[ON_CV_INPUT].getVoltage())) {
-			if (!audition_mixer) {
+			if (!audition.active) {
 				auto_override = false;   // do not override automation
 				school_fader.on = !school_fader.on;
 			}
@@ -161,14 +169,9 @@ struct SchoolBus : Module {
 		if (blue_post_trigger.process(params[BLUE_POST_PARAM].getValue())) post_fades[0] = !post_fades[0];
 		if (orange_post_trigger.process(params[ORANGE_POST_PARAM].getValue())) post_fades[1] = !post_fades[1];
 
-		// process fade states and light
-		if (light_divider.process()) {
-
-			if (use_default_theme) {
-				color_theme = gtg_default_theme;
-			}
-
-			if (audition_mixer) {   // all mixers are in audition state
+		// apply audition changes on the same frame as other mixers
+		if (audition_changed) {
+			if (audition.active) {   // all mixers are in audition state
 
 				// bypass all fade automation
 				auto_override = true;
@@ -199,6 +202,10 @@ struct SchoolBus : Module {
 				// turn off auditions
 				auditioned = false;
 			}
+		}
+
+		// process fade states and light
+		if (light_divider.process()) {
 
 			// process fade speed changes if dragging slider
 			if (!auto_override) {
@@ -218,7 +225,7 @@ struct SchoolBus : Module {
 			lights[ORANGE_POST_LIGHT].value = post_fades[1];
 
 			if (school_fader.getFade() == school_fader.getGain()) {
-				if (audition_mixer) {
+				if (audition.active) {
 					lights[ON_LIGHT + 0].value = 1.f;   // yellow when auditioned
 					lights[ON_LIGHT + 1].value = 1.f;
 				} else {
@@ -292,16 +299,26 @@ struct SchoolBus : Module {
 			}
 		}
 
-		// process outputs
+		// get sends for 3 stereo buses
+		float bus_sends[6];
 		for (int sb = 0; sb < 3; sb++) {   // sb = stereo bus
 			for (int c = 0; c < 2; c++) {
-				int bus_channel = (2 * sb) + c;
-				outputs[BUS_OUTPUT].setVoltage((stereo_in[c] * in_levels[sb]) + inputs[BUS_INPUT].getPolyVoltage(bus_channel), bus_channel);
+				bus_sends[(2 * sb) + c] = stereo_in[c] * in_levels[sb];
 			}
 		}
 
-		// set bus outputs for 3 stereo buses out
-		outputs[BUS_OUTPUT].setChannels(6);
+		// process outputs, sends go to the selected rig and the other rig passes through
+		BusFrame bus_frame;
+		bus_frame.load(inputs[BUS_INPUT]);
+		bus_frame.addRig(bus_rig, bus_sends);
+		int bus_channels = busChannels(inputs[BUS_INPUT], bus_rig);
+		bus_frame.store(outputs[BUS_OUTPUT], bus_channels);
+		station_publisher.publish(args.frame, bus_frame, bus_channels);
+	}
+
+	// pass the bus chain through when bypassed
+	void processBypass(const ProcessArgs &args) override {
+		bypassBus(inputs[BUS_INPUT], outputs[BUS_OUTPUT]);
 	}
 
 	// load on, post fades, and gain states
@@ -315,9 +332,12 @@ struct SchoolBus : Module {
 		json_object_set_new(rootJ, "level_cv_filter", json_integer(level_cv_filter));
 		json_object_set_new(rootJ, "fade_in", json_real(fade_in));
 		json_object_set_new(rootJ, "fade_out", json_real(fade_out));
-		json_object_set_new(rootJ, "audition_mixer", json_integer(audition_mixer));
+		json_object_set_new(rootJ, "audition_mixer", json_integer(audition.isActive()));
+		json_object_set_new(rootJ, "audition_group", json_integer(audition.group));
 		json_object_set_new(rootJ, "auditioned", json_integer(auditioned));
 		json_object_set_new(rootJ, "temped", json_integer(school_fader.temped));
+		json_object_set_new(rootJ, "bus_rig", json_integer(bus_rig));
+		json_object_set_new(rootJ, "publish_station", json_integer(station_publisher.station));
 		json_object_set_new(rootJ, "color_theme", json_integer(color_theme));
 		json_object_set_new(rootJ, "use_default_theme", json_integer(use_default_theme));
 		return rootJ;
@@ -349,24 +369,31 @@ struct SchoolBus : Module {
 		if (fade_inJ) fade_in = json_real_value(fade_inJ);
 		json_t *fade_outJ = json_object_get(rootJ, "fade_out");
 		if (fade_outJ) fade_out = json_real_value(fade_outJ);
+		json_t *audition_groupJ = json_object_get(rootJ, "audition_group");
+		if (audition_groupJ) audition.setGroup(json_integer_value(audition_groupJ));
 		json_t *audition_mixerJ = json_object_get(rootJ, "audition_mixer");
 		if (audition_mixerJ) {
-			audition_mixer = json_integer_value(audition_mixerJ);
+			audition.set(json_integer_value(audition_mixerJ), APP->engine->getFrame());
 		} else {
-			audition_mixer = false;   // no auditioning when loading old patch right after auditioned patch
+			audition.set(false, APP->engine->getFrame());   // no auditioning when loading old patch right after auditioned patch
 		}
 		json_t *auditionedJ = json_object_get(rootJ, "auditioned");
 		if (auditionedJ) auditioned = json_integer_value(auditionedJ);
 		json_t *tempedJ = json_object_get(rootJ, "temped");
 		if (tempedJ) school_fader.temped = json_integer_value(tempedJ);
+		json_t *bus_rigJ = json_object_get(rootJ, "bus_rig");
+		if (bus_rigJ) bus_rig = json_integer_value(bus_rigJ);
 		json_t *use_default_themeJ = json_object_get(rootJ, "use_default_theme");
 		if (use_default_themeJ) {
 			use_default_theme = json_integer_value(use_default_themeJ);
 		} else {
 			if (input_onJ) use_default_theme = false;   // do not change existing patches
 		}
+		json_t *publish_stationJ = json_object_get(rootJ, "publish_station");
+		if (publish_stationJ) station_publisher.station = json_integer_value(publish_stationJ);
 		json_t *color_themeJ = json_object_get(rootJ, "color_theme");
 		if (color_themeJ) color_theme = json_integer_value(color_themeJ);
+		notifyGtgThemeChange();
 	}
 
 	// reset fader speed on sample rate change
@@ -395,28 +422,21 @@ struct SchoolBus : Module {
 		post_fades[1] = post_fades[0];
 		pan_cv_filter = true;
 		level_cv_filter = true;
-		audition_mixer = false;
+		bus_rig = 0;
+		audition.set(false, APP->engine->getFrame());
+		audition.setGroup(0);
+		station_publisher.station = -1;
 	}
 };
 
 
 struct SchoolBusWidget : ModuleWidget {
-	SvgPanel* night_panel;
+	SvgPanel* night_panel = NULL;   // created the first time Night Ride is shown
+	int theme_generation = -1;
 
 	SchoolBusWidget(SchoolBus *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/SchoolBus.svg")));
-
-		// load night panel if not preview
-#ifndef USING_CARDINAL_NOT_RACK
-		if (module)
-#endif
-		{
-			night_panel = new SvgPanel();
-			night_panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/SchoolBus_Night.svg")));
-			night_panel->visible = false;
-			addChild(night_panel);
-		}
+		setPanel(loadGtgPanelSvg("SchoolBus", 0));
 
 		addChild(createThemedWidget<gtgScrewUp>(Vec(RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
 		addChild(createThemedWidget<gtgScrewUp>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0), module ? &module->color_theme : NULL));
@@ -566,6 +586,7 @@ struct SchoolBusWidget : ModuleWidget {
 					module->use_default_theme = false;
 					module->color_theme = theme;
 				}
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -575,6 +596,7 @@ struct SchoolBusWidget : ModuleWidget {
 			void onAction(const event::Action &e) override {
 				gtg_default_theme = theme;
 				saveGtgPluginDefault("default_theme", theme);
+				notifyGtgThemeChange();
 			}
 		};
 
@@ -646,6 +668,21 @@ struct SchoolBusWidget : ModuleWidget {
 		postFadesItem->module = module;
 		menu->addChild(postFadesItem);
 
+		BusRigsItem *busRigsItem = createMenuItem<BusRigsItem>("Bus Rig");
+		busRigsItem->rightText = RIGHT_ARROW;
+		busRigsItem->bus_rig = &(module->bus_rig);
+		menu->addChild(busRigsItem);
+
+		AuditionGroupsItem *auditionGroupsItem = createMenuItem<AuditionGroupsItem>("Audition Group");
+		auditionGroupsItem->rightText = RIGHT_ARROW;
+		auditionGroupsItem->audition = &(module->audition);
+		menu->addChild(auditionGroupsItem);
+
+		StationsItem *stationsItem = createMenuItem<StationsItem>("Publish to Station");
+		stationsItem->rightText = RIGHT_ARROW;
+		stationsItem->station = &(module->station_publisher.station);
+		menu->addChild(stationsItem);
+
 #ifndef USING_CARDINAL_NOT_RACK
 		menu->addChild(new MenuEntry);
 
@@ -656,19 +693,19 @@ struct SchoolBusWidget : ModuleWidget {
 #endif
 	}
 
-	// display panel based on theme
+	// display panel and components when the theme changes
 	void step() override {
 #ifdef USING_CARDINAL_NOT_RACK
-		Widget* panel = getPanel();
-		panel->visible = !settings::darkMode;
-		night_panel->visible = settings::darkMode;
-#else
-		if (module) {
-			Widget* panel = getPanel();
-			panel->visible = ((((SchoolBus*)module)->color_theme) == 0);
-			night_panel->visible = ((((SchoolBus*)module)->color_theme) == 1);
-		}
+		showGtgNightPanel(this, night_panel, "SchoolBus", settings::darkMode);
 #endif
+		if (module && gtgThemeChanged(theme_generation)) {
+			SchoolBus *themed_module = (SchoolBus*)module;
+			if (themed_module->use_default_theme) themed_module->color_theme = gtg_default_theme;
+#ifndef USING_CARDINAL_NOT_RACK
+			showGtgNightPanel(this, night_panel, "SchoolBus", themed_module->color_theme == 1);
+#endif
+			updateGtgThemes(this);
+		}
 		Widget::step();
 	}
 };
@@ -0,0 +1,8 @@
+#include "gtgAudition.hpp"
+
+
+const char *audition_group_names[AUDITION_GROUPS] = {"Main", "Group A", "Group B", "Group C", "Group D", "Group E", "Group F", "Group G", "Group H"};
+
+// auditions of the main scope and of each group
+AuditionState mixer_auditions[AUDITION_GROUPS];
+AuditionState depot_auditions[AUDITION_GROUPS];
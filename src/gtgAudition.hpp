@@ -0,0 +1,109 @@
+#pragma once
+#include "plugin.hpp"
+#include <atomic>
+
+
+// audition state shared by a group of mixers or depots without locks
+// each change bumps an epoch and is stamped with the next engine frame, so every module applies it on the same frame
+// the apply frame, epoch and on state are packed in one atomic, so modules check for changes with one relaxed load
+
+struct AuditionState {
+
+	void set(bool active, int64_t frame) {
+		uint64_t state = packed.load(std::memory_order_relaxed);
+		uint64_t next_state;
+		do {
+			uint64_t epoch = ((state >> 1) + 1) & 0x7FFF;
+			next_state = ((uint64_t)(frame + 1) << 16) | (epoch << 1) | (active ? 1 : 0);
+		} while (!packed.compare_exchange_weak(state, next_state, std::memory_order_relaxed));
+	}
+
+	bool isActive() {   // the latest state, which may not be applied yet
+		return packed.load(std::memory_order_relaxed) & 1;
+	}
+
+	uint64_t load() {
+		return packed.load(std::memory_order_relaxed);
+	}
+
+private:
+
+	std::atomic<uint64_t> packed{0};
+};
+
+
+// audition scopes, modules start in the main scope and each scope is independent of the others
+const int AUDITION_GROUPS = 9;
+
+extern const char *audition_group_names[AUDITION_GROUPS];
+extern AuditionState mixer_auditions[AUDITION_GROUPS];
+extern AuditionState depot_auditions[AUDITION_GROUPS];
+
+
+// follows the audition of a module's group from process()
+// the group's state is looked up when the group changes, never per sample
+struct AuditionFollower {
+
+	bool active = false;   // applied audition state
+	int group = 0;
+
+	AuditionFollower(AuditionState *_auditions) {
+		auditions = _auditions;
+		scope = &auditions[0];
+	}
+
+	void setGroup(int new_group) {
+		group = clamp(new_group, 0, AUDITION_GROUPS - 1);
+		scope = &auditions[group];
+	}
+
+	void set(bool new_active, int64_t frame) {   // audition or stop auditioning the group
+		scope.load(std::memory_order_relaxed)->set(new_active, frame);
+	}
+
+	bool isActive() {
+		return scope.load(std::memory_order_relaxed)->isActive();
+	}
+
+	// returns true on the frame a new audition state applies
+	bool process(int64_t frame) {
+		uint64_t state = scope.load(std::memory_order_relaxed)->load();
+		if (state == seen) return false;
+		if (frame < (int64_t)(state >> 16)) return false;   // wait for the apply frame
+		seen = state;
+		active = state & 1;
+		return true;
+	}
+
+private:
+
+	AuditionState *auditions;
+	std::atomic<AuditionState*> scope;
+	uint64_t seen = 0;
+};
+
+
+// audition group menu items
+struct AuditionGroupItem : MenuItem {
+	AuditionFollower *audition = NULL;
+	int group = 0;
+	void onAction(const event::Action &e) override {
+		audition->setGroup(group);
+	}
+};
+
+struct AuditionGroupsItem : MenuItem {
+	AuditionFollower *audition = NULL;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		for (int i = 0; i < AUDITION_GROUPS; i++) {
+			AuditionGroupItem *group_item = new AuditionGroupItem;
+			group_item->text = (i == 0) ? "Main (default)" : audition_group_names[i];
+			group_item->rightText = CHECKMARK(audition->group == i);
+			group_item->audition = audition;
+			group_item->group = i;
+			menu->addChild(group_item);
+		}
+		return menu;
+	}
+};
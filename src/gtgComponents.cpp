@@ -1,6 +1,64 @@
 #include "gtgComponents.hpp"
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 
+// shared svgs, only widgets created on the UI thread use the cache
+static std::map<std::string, std::shared_ptr<Svg>> gtg_svgs;
+
+std::shared_ptr<Svg> loadGtgSvg(const std::string &name) {
+	auto found = gtg_svgs.find(name);
+	if (found != gtg_svgs.end()) return found->second;
+	std::shared_ptr<Svg> svg = APP->window->loadSvg(asset::plugin(pluginInstance, "res/" + name));
+	gtg_svgs[name] = svg;
+	return svg;
+}
+
+std::shared_ptr<Svg> loadGtgPanelSvg(const std::string &panel, int theme) {
+	return loadGtgSvg(theme == 1 ? panel + "_Night.svg" : panel + ".svg");
+}
+
+// lazy night panels
+void showGtgNightPanel(ModuleWidget *widget, SvgPanel *&night_panel, const std::string &panel, bool night) {
+	if (night) {
+		if (!night_panel) {
+			night_panel = new SvgPanel();
+			night_panel->setBackground(loadGtgPanelSvg(panel, 1));
+			widget->addChildAbove(night_panel, widget->getPanel());   // below the components
+		}
+	} else if (night_panel) {
+		widget->removeChild(night_panel);   // frees its framebuffer, the svg stays cached
+		delete night_panel;
+		night_panel = NULL;
+	}
+	widget->getPanel()->visible = !night;
+}
+
+// theme change notification
+static std::atomic<int> gtg_theme_generation{0};
+
+void notifyGtgThemeChange() {
+	gtg_theme_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool gtgThemeChanged(int &generation) {
+	int current = gtg_theme_generation.load(std::memory_order_relaxed);
+	if (current == generation) return false;
+	generation = current;
+	return true;
+}
+
+void updateGtgThemes(Widget *widget) {
+	for (Widget *child : widget->children) {
+		GtgThemed *themed = dynamic_cast<GtgThemed*>(child);
+		if (themed) themed->updateTheme();
+		else updateGtgThemes(child);
+	}
+}
+
 // themed button (switch)
 void ThemedSvgSwitch::addFrameAll(std::shared_ptr<Svg> svg) {
 	framesAll.push_back(svg);
@@ -10,21 +68,18 @@ void ThemedSvgSwitch::addFrameAll(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void ThemedSvgSwitch::step() {
-	if(theme != NULL && *theme != old_theme) {
-		if ((*theme) == 0 || framesAll.size() < 4) {
-			frames[0]=framesAll[0];
-			frames[1]=framesAll[1];
-		}
-		else {
-			frames[0]=framesAll[2];
-			frames[1]=framesAll[3];
-		}
-		old_theme = *theme;
-		onChange(*(new event::Change()));
-		fb->dirty = true;
+void ThemedSvgSwitch::setTheme(int new_theme) {
+	if (new_theme == 0 || framesAll.size() < 4) {
+		frames[0]=framesAll[0];
+		frames[1]=framesAll[1];
+	}
+	else {
+		frames[0]=framesAll[2];
+		frames[1]=framesAll[3];
 	}
-	SvgSwitch::step();
+	event::Change change;   // picks the frame for the current value
+	onChange(change);
+	fb->dirty = true;
 }
 
 // themed knob
@@ -35,18 +90,14 @@ void ThemedSvgKnob::addFrameAll(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void ThemedSvgKnob::step() {
-	if(theme != NULL && *theme != old_theme) {
-		if ((*theme) == 0) {
-			setSvg(framesAll[0]);
-		}
-		else {
-			setSvg(framesAll[1]);
-		}
-		old_theme = *theme;
-		fb->dirty = true;
+void ThemedSvgKnob::setTheme(int new_theme) {
+	if (new_theme == 0) {
+		setSvg(framesAll[0]);
+	}
+	else {
+		setSvg(framesAll[1]);
 	}
-	SvgKnob::step();
+	fb->dirty = true;
 }
 
 // themed snap knob
@@ -57,18 +108,14 @@ void ThemedRoundBlackSnapKnob::addFrameAll(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void ThemedRoundBlackSnapKnob::step() {
-	if(theme != NULL && *theme != old_theme) {
-		if ((*theme) == 0) {
-			setSvg(framesAll[0]);
-		}
-		else {
-			setSvg(framesAll[1]);
-		}
-		old_theme = *theme;
-		fb->dirty = true;
+void ThemedRoundBlackSnapKnob::setTheme(int new_theme) {
+	if (new_theme == 0) {
+		setSvg(framesAll[0]);
+	}
+	else {
+		setSvg(framesAll[1]);
 	}
-	SvgKnob::step();
+	fb->dirty = true;
 }
 
 // themed port
@@ -79,13 +126,9 @@ void ThemedSvgPort::addFrame(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void ThemedSvgPort::step() {
-	if(theme != NULL && *theme != old_theme) {
-		sw->setSvg(frames[*theme]);
-		old_theme = *theme;
-		fb->dirty = true;
-	}
-	PortWidget::step();
+void ThemedSvgPort::setTheme(int new_theme) {
+	sw->setSvg(frames[new_theme]);
+	fb->dirty = true;
 }
 
 // themed screw
@@ -96,60 +139,319 @@ void ThemedSvgScrew::addFrame(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void ThemedSvgScrew::step() {
-	if(theme != NULL && *theme != old_theme) {
-		sw->setSvg(frames[*theme]);
-		old_theme = *theme;
-		fb->dirty = true;
+void ThemedSvgScrew::setTheme(int new_theme) {
+	sw->setSvg(frames[new_theme]);
+	fb->dirty = true;
+}
+
+// number display
+void GtgNumberText::draw(const DrawArgs &args) {
+	// background
+	nvgBeginPath(args.vg);
+	nvgRoundedRect(args.vg, 0.0, 0.0, box.size.x, box.size.y, 1.5);
+	nvgFillColor(args.vg, background_color);
+	nvgFill(args.vg);
+
+	// display text
+	if (!font) font = APP->window->loadFont(asset::plugin(pluginInstance, font_path));
+	if (font) {
+		nvgFontSize(args.vg, font_size);
+		nvgFontFaceId(args.vg, font->handle);
+		nvgTextLetterSpacing(args.vg, 0.5);
+		nvgTextAlign(args.vg, NVG_ALIGN_RIGHT);
+		nvgFillColor(args.vg, text_color);
+		nvgText(args.vg, text_pos.x, text_pos.y, text.c_str(), NULL);
 	}
-	SvgScrew::step();
 }
 
-// save a plugin default integer
-void saveGtgPluginDefault(const char* plugin_setting, int setting_value) {
-	json_t *settingsJ = json_object();
-	std::string settingsFilename = asset::user("GlueTheGiant.json");
+GtgNumberDisplay::GtgNumberDisplay() {
+	number_text = new GtgNumberText;
+	addChild(number_text);
+}
+
+void GtgNumberDisplay::step() {
+	float value = getValue();
+	if (!shown || value != shown_value) {
+		shown_value = value;
+		shown = true;
+		number_text->text = formatValue(value);
+		number_text->box.size = box.size;
+		dirty = true;
+	}
+	FramebufferWidget::step();
+}
 
-	FILE *file;
+// vu meter
+void GtgVuMeter::setBusScale() {
+	NVGcolor red = nvgRGB(0xed, 0x2c, 0x24);
+	NVGcolor yellow = nvgRGB(0xf9, 0xdf, 0x1c);
+	NVGcolor green = nvgRGB(0x90, 0xc7, 0x3e);
+	segments = {
+		{0.f, 0.f, red, true},
+		{-3.f, 0.f, yellow, false},
+		{-6.f, -3.f, green, false},
+		{-9.f, -6.f, green, false},
+		{-12.f, -9.f, green, false},
+		{-15.f, -12.f, green, false},
+		{-19.f, -15.f, green, false},
+		{-24.f, -19.f, green, false},
+		{-30.f, -24.f, green, false},
+		{-36.f, -28.f, green, false},
+		{-48.f, -36.f, green, false}
+	};
+}
 
-	file = fopen(settingsFilename.c_str(), "r");
-	if (file) {
-		json_error_t error;
-		settingsJ = json_loadf(file, 0, &error);
-		fclose(file);
+float GtgVuMeter::getBrightness(const GtgVuSegment &segment) {
+	if (segment.clip) return peak ? peak->load(std::memory_order_relaxed) : 0.f;
+	if (db >= segment.db_max) return 1.f;
+	if (db <= segment.db_min) return 0.f;
+	return math::rescale(db, segment.db_min, segment.db_max, 0.f, 1.f);
+}
+
+Vec GtgVuMeter::segmentCenter(int segment) {
+	return Vec(radius, radius + segment * spacing);
+}
+
+void GtgVuMeter::step() {
+	float amplitude = level ? level->load(std::memory_order_relaxed) : 0.f;
+	db = (amplitude > 0.00001f) ? 20.f * std::log10(amplitude) : -100.f;
+
+	// hold the peak for a second, then let it fall
+	if (db >= hold_db) {
+		hold_db = db;
+		hold_time = 1.f;
+	} else if (hold_time > 0.f) {
+		hold_time -= APP->window->getLastFrameDuration();
+	} else {
+		hold_db = std::max(db, hold_db - 20.f * (float)APP->window->getLastFrameDuration());
 	}
+	TransparentWidget::step();
+}
 
-	json_object_set_new(settingsJ, plugin_setting, json_integer(setting_value));
+void GtgVuMeter::draw(const DrawArgs &args) {
+	// unlit segments
+	for (int i = 0; i < (int)segments.size(); i++) {
+		Vec center = segmentCenter(i);
+		nvgBeginPath(args.vg);
+		nvgCircle(args.vg, center.x, center.y, radius);
+		nvgFillColor(args.vg, nvgRGB(0x33, 0x33, 0x33));
+		nvgFill(args.vg);
+	}
+}
 
-	file = fopen(settingsFilename.c_str(), "w");
-	if (file) {
-		json_dumpf(settingsJ, file, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
-		fclose(file);
+void GtgVuMeter::drawLayer(const DrawArgs &args, int layer) {
+	if (layer != 1) return;
+
+	// lit segments, with the peak hold line above the highest segment it reaches
+	int hold_segment = -1;
+	for (int i = 0; i < (int)segments.size(); i++) {
+		GtgVuSegment &segment = segments[i];
+		if (hold_segment < 0 && !segment.clip && hold_db > segment.db_min) hold_segment = i;
+		float brightness = getBrightness(segment);
+		if (brightness <= 0.f) continue;
+		Vec center = segmentCenter(i);
+		NVGcolor color = segment.color;
+		color.a = brightness;
+		nvgBeginPath(args.vg);
+		nvgCircle(args.vg, center.x, center.y, radius);
+		nvgFillColor(args.vg, color);
+		nvgFill(args.vg);
+	}
+	if (hold_segment >= 0) {
+		Vec center = segmentCenter(hold_segment);
+		nvgBeginPath(args.vg);
+		nvgRect(args.vg, 0.f, center.y - radius, 2.f * radius, 0.5f);
+		nvgFillColor(args.vg, segments[hold_segment].color);
+		nvgFill(args.vg);
 	}
+}
 
-	json_decref(settingsJ);
+GtgVuMeter *createGtgVuMeter(Vec top_center, float spacing, float radius, std::atomic<float> *level, std::atomic<float> *peak) {
+	GtgVuMeter *meter = new GtgVuMeter;
+	meter->setBusScale();
+	meter->spacing = mm2px(Vec(0.f, spacing)).y;
+	meter->radius = mm2px(Vec(0.f, radius)).y;
+	meter->level = level;
+	meter->peak = peak;
+	meter->box.pos = mm2px(top_center.minus(Vec(radius, radius)));
+	meter->box.size = Vec(2.f * meter->radius, 2.f * meter->radius + (meter->segments.size() - 1) * meter->spacing);
+	return meter;
 }
 
-// load a plugin default integer
-int loadGtgPluginDefault(const char* plugin_setting, int default_value) {
+// plugin settings from GlueTheGiant.json, loaded once in init() and read by modules without opening the file
+// only the UI thread adds settings, so the count is published after a new name is in place
+
+const int GTG_SETTINGS = 16;
+
+struct GtgSetting {
+	std::string name;
+	std::atomic<int> value{0};
+};
+
+static GtgSetting gtg_settings[GTG_SETTINGS];
+static std::atomic<int> gtg_settings_count{0};
+
+static GtgSetting *findGtgSetting(const char* plugin_setting) {
+	int count = gtg_settings_count.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		if (gtg_settings[i].name == plugin_setting) return &gtg_settings[i];
+	}
+	return NULL;
+}
+
+static void setGtgSetting(const char* plugin_setting, int setting_value) {
+	GtgSetting *setting = findGtgSetting(plugin_setting);
+	if (!setting) {
+		int count = gtg_settings_count.load(std::memory_order_relaxed);
+		if (count >= GTG_SETTINGS) return;   // no room for more settings
+		setting = &gtg_settings[count];
+		setting->name = plugin_setting;
+		setting->value.store(setting_value, std::memory_order_relaxed);
+		gtg_settings_count.store(count + 1, std::memory_order_release);
+	}
+	setting->value.store(setting_value, std::memory_order_relaxed);
+}
+
+// read the settings file into the settings table
+void loadGtgPluginSettings() {
 	std::string settingsFilename = asset::user("GlueTheGiant.json");
 
 	FILE *file = fopen(settingsFilename.c_str(), "r");
 	if (!file) {   // file does not exist
-		return default_value;
+		return;
 	}
 
 	json_error_t error;
 	json_t *settingsJ = json_loadf(file, 0, &error);
+	fclose(file);
 	if (!settingsJ) {   // file invalid
+		return;
+	}
+
+	const char *key;
+	json_t *valueJ;
+	json_object_foreach(settingsJ, key, valueJ) {
+		if (json_is_integer(valueJ)) setGtgSetting(key, json_integer_value(valueJ));
+	}
+
+	json_decref(settingsJ);
+}
+
+// write the settings table over the settings file, keeping settings that are not in the table
+static void writeGtgPluginSettings() {
+	std::string settingsFilename = asset::user("GlueTheGiant.json");
+	std::string tempFilename = settingsFilename + ".tmp";
+
+	json_t *settingsJ = NULL;
+	FILE *file = fopen(settingsFilename.c_str(), "r");
+	if (file) {
+		json_error_t error;
+		settingsJ = json_loadf(file, 0, &error);
 		fclose(file);
-		return default_value;
 	}
+	if (!settingsJ) settingsJ = json_object();   // no file or file invalid
 
-	json_t *default_valueJ = json_object_get(settingsJ, plugin_setting);
-	if (default_valueJ) default_value = json_integer_value(default_valueJ);
-	fclose(file);
+	int count = gtg_settings_count.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		json_object_set_new(settingsJ, gtg_settings[i].name.c_str(), json_integer(gtg_settings[i].value.load(std::memory_order_relaxed)));
+	}
+
+	// write a temporary file and rename it, so a crash never leaves a half written settings file
+	file = fopen(tempFilename.c_str(), "w");
+	if (file) {
+		int result = json_dumpf(settingsJ, file, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
+		if (fclose(file) == 0 && result == 0) {
+			system::rename(tempFilename, settingsFilename);
+		} else {
+			system::remove(tempFilename);
+		}
+	}
 
 	json_decref(settingsJ);
+}
+
+// writes settings on a background thread, saves made within a short window are written once
+struct GtgSettingsWriter {
+
+	void request() {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->pending = true;
+		state->due = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		if (!thread.joinable()) {
+			std::shared_ptr<WriterState> thread_state = state;
+			thread = std::thread([thread_state] {run(thread_state);});
+		}
+		state->cv.notify_all();
+	}
+
+	~GtgSettingsWriter() {
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->stopping = true;
+		state->cv.notify_all();
+		if (!thread.joinable()) return;
+#ifdef ARCH_WIN
+		// joining while the plugin is unloaded can deadlock on Windows
+		// so wait out a write in progress, write what is pending here, and let the thread end on its own
+		state->cv.wait(lock, [this] {return !state->writing;});
+		if (state->pending) writeGtgPluginSettings();
+		state->pending = false;
+		lock.unlock();
+		thread.detach();   // the thread holds its own reference to the state
+#else
+		lock.unlock();
+		thread.join();   // writes a pending save first
+#endif
+	}
+
+private:
+
+	// shared with the thread, so it outlives the writer if the thread is detached
+	struct WriterState {
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::chrono::steady_clock::time_point due;
+		bool pending = false;
+		bool stopping = false;
+		bool writing = false;
+	};
+
+	std::shared_ptr<WriterState> state = std::make_shared<WriterState>();
+	std::thread thread;
+
+	static void run(std::shared_ptr<WriterState> state) {
+		std::unique_lock<std::mutex> lock(state->mutex);
+		while (true) {
+			state->cv.wait(lock, [&state] {return state->pending || state->stopping;});
+			if (!state->pending) return;   // stopping with nothing to write
+
+			// wait until saves stop coming in
+			while (!state->stopping && std::chrono::steady_clock::now() < state->due) {
+				state->cv.wait_until(lock, state->due);
+			}
+			if (!state->pending) return;   // written by the writer while stopping
+
+			state->pending = false;
+			state->writing = true;
+			lock.unlock();
+			writeGtgPluginSettings();
+			lock.lock();
+			state->writing = false;
+			state->cv.notify_all();
+		}
+	}
+};
+
+static GtgSettingsWriter gtg_settings_writer;
+
+// save a plugin default integer, the file is written in the background
+void saveGtgPluginDefault(const char* plugin_setting, int setting_value) {
+	setGtgSetting(plugin_setting, setting_value);
+	gtg_settings_writer.request();
+}
+
+// load a plugin default integer from the settings table
+int loadGtgPluginDefault(const char* plugin_setting, int default_value) {
+	GtgSetting *setting = findGtgSetting(plugin_setting);
+	if (setting) default_value = setting->value.load(std::memory_order_relaxed);
 	return default_value;
 }
@@ -14,6 +14,40 @@ using namespace rack;
 extern Plugin *pluginInstance;
 
 
+// shows the night or day panel of a module widget
+// the night panel is created the first time it is shown and deleted when the day panel is shown again
+void showGtgNightPanel(ModuleWidget *widget, SvgPanel *&night_panel, const std::string &panel, bool night);
+
+// theme changes bump a generation count, module widgets pass a change on to their themed components
+// so components never check their theme while nothing has changed
+
+void notifyGtgThemeChange();   // call after changing a module theme or the default theme
+
+bool gtgThemeChanged(int &generation);   // true once after each change, generation starts at -1
+
+void updateGtgThemes(Widget *widget);   // update every themed component below widget
+
+struct GtgThemed {
+	int* theme = NULL;
+	int old_theme = -1;
+
+	virtual ~GtgThemed() {}
+	virtual void setTheme(int new_theme) = 0;
+
+	void updateTheme() {
+		if (theme != NULL && *theme != old_theme) {
+			old_theme = *theme;
+			setTheme(old_theme);
+		}
+	}
+};
+
+// plugin svgs are loaded once and shared by every widget, names are relative to res/
+std::shared_ptr<Svg> loadGtgSvg(const std::string &name);
+
+// panel svg for a theme, res/<panel>.svg for 70's Cream and res/<panel>_Night.svg for Night Ride
+std::shared_ptr<Svg> loadGtgPanelSvg(const std::string &panel, int theme);
+
 // themed button and knob params
 template <class TThemedParam>
 TThemedParam* createThemedParamCentered(Vec pos, Module *module, int paramId, int* theme) {
@@ -22,33 +56,27 @@ TThemedParam* createThemedParamCentered(Vec pos, Module *module, int paramId, in
 	return o;
 }
 
-struct ThemedSvgSwitch : SvgSwitch {
-	int* theme = NULL;
-	int old_theme = -1;
+struct ThemedSvgSwitch : SvgSwitch, GtgThemed {
 	std::vector<std::shared_ptr<Svg>> framesAll;
 
 	void addFrameAll(std::shared_ptr<Svg> svg);
-	void step() override;
+	void setTheme(int new_theme) override;
 };
 
-struct ThemedSvgKnob : SvgKnob {
-	int* theme = NULL;
-	int old_theme = -1;
+struct ThemedSvgKnob : SvgKnob, GtgThemed {
 	std::vector<std::shared_ptr<Svg>> framesAll;
 
 	void setOrientation(float angle);
 	void addFrameAll(std::shared_ptr<Svg> svg);
-	void step() override;
+	void setTheme(int new_theme) override;
 };
 
-struct ThemedRoundBlackSnapKnob : SvgKnob {
-	int* theme = NULL;
-	int old_theme = -1;
+struct ThemedRoundBlackSnapKnob : SvgKnob, GtgThemed {
 	std::vector<std::shared_ptr<Svg>> framesAll;
 
 	void setOrientation(float angle);
 	void addFrameAll(std::shared_ptr<Svg> svg);
-	void step() override;
+	void setTheme(int new_theme) override;
 };
 
 // themed port widgets
@@ -61,13 +89,11 @@ TThemedPort* createThemedPortCentered(Vec pos, bool isInput, Module *module, int
 	return o;
 }
 
-struct ThemedSvgPort : SvgPort {
-	int* theme = NULL;
-	int old_theme = -1;
+struct ThemedSvgPort : SvgPort, GtgThemed {
 	std::vector<std::shared_ptr<Svg>> frames;
 
 	void addFrame(std::shared_ptr<Svg> svg);
-	void step() override;
+	void setTheme(int new_theme) override;
 };
 
 // themed widgets for screws
@@ -78,15 +104,75 @@ TWidget *createThemedWidget(Vec pos, int* theme) {
 	return o;
 }
 
-struct ThemedSvgScrew : SvgScrew {
-	int* theme = NULL;
-	int old_theme = -1;
+struct ThemedSvgScrew : SvgScrew, GtgThemed {
 	std::vector<std::shared_ptr<Svg>> frames;
 
 	void addFrame(std::shared_ptr<Svg> svg);
+	void setTheme(int new_theme) override;
+};
+
+// numeric readouts kept in a framebuffer and only redrawn when their value changes
+// subclasses give the value and its text, e.g. delay in samples or milliseconds, LUFS or gain reduction
+struct GtgNumberText : Widget {
+	std::string text;
+	std::string font_path = "res/fonts/DSEG7-Classic-MINI/DSEG7ClassicMini-Bold.ttf";
+	std::shared_ptr<Font> font;   // loaded on the first draw
+	float font_size = 6.f;
+	Vec text_pos;   // right aligned
+	NVGcolor text_color = nvgRGB(0x90, 0xc7, 0x3e);
+	NVGcolor background_color = nvgRGB(26, 26, 26);
+
+	void draw(const DrawArgs &args) override;
+};
+
+struct GtgNumberDisplay : FramebufferWidget {
+	GtgNumberText *number_text;
+
+	GtgNumberDisplay();
+	virtual float getValue() = 0;
+	virtual std::string formatValue(float value) = 0;
+	void step() override;
+
+private:
+
+	float shown_value = 0.f;
+	bool shown = false;
+};
+
+// vu meter ladder drawn by one widget from level snapshots written by the module
+// segments run top to bottom, a clip segment shows the peak brightness instead of a level
+struct GtgVuSegment {
+	float db_min;
+	float db_max;
+	NVGcolor color;
+	bool clip;
+};
+
+struct GtgVuMeter : TransparentWidget {
+	std::atomic<float> *level = NULL;   // vu meter amplitude, NULL in the module browser
+	std::atomic<float> *peak = NULL;   // clip brightness
+	std::vector<GtgVuSegment> segments;
+	float spacing = 0.f;   // between segment centers
+	float radius = 0.f;
+
+	void setBusScale();   // clip, 0 to -15 dB in 3 dB steps, then down to -48 dB
+	void draw(const DrawArgs &args) override;
+	void drawLayer(const DrawArgs &args, int layer) override;
 	void step() override;
+
+private:
+
+	float db = -100.f;
+	float hold_db = -100.f;   // peak hold line
+	float hold_time = 0.f;
+
+	float getBrightness(const GtgVuSegment &segment);
+	Vec segmentCenter(int segment);
 };
 
+// a vu meter column with its first segment centered on top_center, all in mm
+GtgVuMeter *createGtgVuMeter(Vec top_center, float spacing, float radius, std::atomic<float> *level, std::atomic<float> *peak);
+
 // long press button, from Audible Instruments Segments (Stages)
 struct LongPressButton {
 	enum Events {
@@ -124,6 +210,8 @@ struct LongPressButton {
 
 // saving and loading default theme
 
+void loadGtgPluginSettings();   // call once in init()
+
 void saveGtgPluginDefault(const char* setting, int value);
 
 int loadGtgPluginDefault(const char* setting, int default_value);
@@ -168,31 +256,92 @@ struct FadeSliderItem : ui::Slider {
 	}
 };
 
+// polyphonic stereo spread for spread slider menu item
+struct PolySpread : Quantity {
+	float *srcSpread = NULL;
+
+	PolySpread(float *_srcSpread) {
+		srcSpread = _srcSpread;
+	}
+	void setValue(float value) override {
+		*srcSpread = math::clamp(value, getMinValue(), getMaxValue());
+	}
+	float getValue() override {
+		return *srcSpread;
+	}
+	float getMinValue() override {return -1.0f;}
+	float getMaxValue() override {return 1.0f;}
+	float getDefaultValue() override {return 0.0f;}
+	float getDisplayValue() override {return getValue() * 100;}
+	std::string getDisplayValueString() override {
+		float value = getDisplayValue();
+		return string::f("%.0f", value);
+	}
+	void setDisplayValue(float displayValue) override {setValue(displayValue / 100);}
+	std::string getLabel() override {return "Spread";}
+	std::string getUnit() override {return "%";}
+};
+
+struct PolySpreadSliderItem : ui::Slider {
+	PolySpreadSliderItem(float *spread) {
+		quantity = new PolySpread(spread);
+	}
+	~PolySpreadSliderItem() {
+		delete quantity;
+	}
+};
+
+// bus rig selection for two rigs on one 12 channel bus cable
+struct BusRigItem : MenuItem {
+	int *bus_rig = NULL;
+	int rig = 0;
+	void onAction(const event::Action &e) override {
+		*bus_rig = rig;
+	}
+};
+
+struct BusRigsItem : MenuItem {
+	int *bus_rig = NULL;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		std::string rig_titles[2] = {"Rig A on channels 1-6 (default)", "Rig B on channels 7-12"};
+		for (int i = 0; i < 2; i++) {
+			BusRigItem *rig_item = new BusRigItem;
+			rig_item->text = rig_titles[i];
+			rig_item->rightText = CHECKMARK(*bus_rig == i);
+			rig_item->bus_rig = bus_rig;
+			rig_item->rig = i;
+			menu->addChild(rig_item);
+		}
+		return menu;
+	}
+};
+
 // custom components
 struct gtgBlackButton : ThemedSvgSwitch {
 	gtgBlackButton() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackButton_0.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackButton_1.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackButton_Night_0.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackButton_Night_1.svg")));
+		addFrameAll(loadGtgSvg("components/BlackButton_0.svg"));
+		addFrameAll(loadGtgSvg("components/BlackButton_1.svg"));
+		addFrameAll(loadGtgSvg("components/BlackButton_Night_0.svg"));
+		addFrameAll(loadGtgSvg("components/BlackButton_Night_1.svg"));
 		momentary = true;
 	}
 };
 
 struct gtgBlackTinyButton : ThemedSvgSwitch {
 	gtgBlackTinyButton() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackTinyButton_0.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackTinyButton_1.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackTinyButton_Night_0.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackTinyButton_Night_1.svg")));
+		addFrameAll(loadGtgSvg("components/BlackTinyButton_0.svg"));
+		addFrameAll(loadGtgSvg("components/BlackTinyButton_1.svg"));
+		addFrameAll(loadGtgSvg("components/BlackTinyButton_Night_0.svg"));
+		addFrameAll(loadGtgSvg("components/BlackTinyButton_Night_1.svg"));
 		momentary = true;
 	}
 };
 
 struct gtgRedKnob : ThemedSvgKnob {
 	gtgRedKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/RedKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/RedKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/RedKnob.svg"));
+		addFrameAll(loadGtgSvg("components/RedKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -201,8 +350,8 @@ struct gtgRedKnob : ThemedSvgKnob {
 
 struct gtgOrangeKnob : ThemedSvgKnob {
 	gtgOrangeKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/OrangeKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/OrangeKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/OrangeKnob.svg"));
+		addFrameAll(loadGtgSvg("components/OrangeKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -211,8 +360,8 @@ struct gtgOrangeKnob : ThemedSvgKnob {
 
 struct gtgBlueKnob : ThemedSvgKnob {
 	gtgBlueKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlueKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlueKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/BlueKnob.svg"));
+		addFrameAll(loadGtgSvg("components/BlueKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -221,8 +370,8 @@ struct gtgBlueKnob : ThemedSvgKnob {
 
 struct gtgGrayKnob : ThemedSvgKnob {
 	gtgGrayKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/GrayKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/GrayKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/GrayKnob.svg"));
+		addFrameAll(loadGtgSvg("components/GrayKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -231,8 +380,8 @@ struct gtgGrayKnob : ThemedSvgKnob {
 
 struct gtgBlackKnob : ThemedSvgKnob {
 	gtgBlackKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/BlackKnob.svg"));
+		addFrameAll(loadGtgSvg("components/BlackKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -241,8 +390,8 @@ struct gtgBlackKnob : ThemedSvgKnob {
 
 struct gtgBlackTinyKnob : ThemedSvgKnob {
 	gtgBlackTinyKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlackTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/BlackTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/BlackTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -251,8 +400,8 @@ struct gtgBlackTinyKnob : ThemedSvgKnob {
 
 struct gtgGrayTinyKnob : ThemedSvgKnob {
 	gtgGrayTinyKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/GrayTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/GrayTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/GrayTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/GrayTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -261,8 +410,8 @@ struct gtgGrayTinyKnob : ThemedSvgKnob {
 
 struct gtgBlueTinyKnob : ThemedSvgKnob {
 	gtgBlueTinyKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlueTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlueTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/BlueTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/BlueTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -271,8 +420,8 @@ struct gtgBlueTinyKnob : ThemedSvgKnob {
 
 struct gtgOrangeTinyKnob : ThemedSvgKnob {
 	gtgOrangeTinyKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/OrangeTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/OrangeTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/OrangeTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/OrangeTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -281,8 +430,8 @@ struct gtgOrangeTinyKnob : ThemedSvgKnob {
 
 struct gtgRedTinyKnob : ThemedSvgKnob {
 	gtgRedTinyKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/RedTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/RedTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/RedTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/RedTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -291,8 +440,8 @@ struct gtgRedTinyKnob : ThemedSvgKnob {
 
 struct gtgBlueTinySnapKnob : ThemedRoundBlackSnapKnob {
 	gtgBlueTinySnapKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlueTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/BlueTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/BlueTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/BlueTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 0.6f;
@@ -301,8 +450,8 @@ struct gtgBlueTinySnapKnob : ThemedRoundBlackSnapKnob {
 
 struct gtgOrangeTinySnapKnob : ThemedRoundBlackSnapKnob {
 	gtgOrangeTinySnapKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/OrangeTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/OrangeTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/OrangeTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/OrangeTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 0.6f;
@@ -311,8 +460,8 @@ struct gtgOrangeTinySnapKnob : ThemedRoundBlackSnapKnob {
 
 struct gtgRedTinySnapKnob : ThemedRoundBlackSnapKnob {
 	gtgRedTinySnapKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/RedTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/RedTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/RedTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/RedTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 0.6f;
@@ -321,8 +470,8 @@ struct gtgRedTinySnapKnob : ThemedRoundBlackSnapKnob {
 
 struct gtgGrayTinySnapKnob : ThemedRoundBlackSnapKnob {
 	gtgGrayTinySnapKnob() {
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/GrayTinyKnob.svg")));
-		addFrameAll(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/GrayTinyKnob_Night.svg")));
+		addFrameAll(loadGtgSvg("components/GrayTinyKnob.svg"));
+		addFrameAll(loadGtgSvg("components/GrayTinyKnob_Night.svg"));
 		minAngle = -0.83 * M_PI;
 		maxAngle = 0.83 * M_PI;
 		speed = 2.2f;
@@ -331,8 +480,8 @@ struct gtgGrayTinySnapKnob : ThemedRoundBlackSnapKnob {
 
 struct gtgNutPort : ThemedSvgPort {
 	gtgNutPort() {
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/NutPort.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/NutPort_Night.svg")));
+		addFrame(loadGtgSvg("components/NutPort.svg"));
+		addFrame(loadGtgSvg("components/NutPort_Night.svg"));
 		shadow->box.size = shadow->box.size.div(1.07);   // slight improvement on huge round shadow
 		shadow->box.pos = Vec(box.size.x * 0.028, box.size.y * 0.094);
 	}
@@ -340,14 +489,14 @@ struct gtgNutPort : ThemedSvgPort {
 
 struct gtgKeyPort : ThemedSvgPort {
 	gtgKeyPort() {
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/KeyPort.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/KeyPort_Night.svg")));
+		addFrame(loadGtgSvg("components/KeyPort.svg"));
+		addFrame(loadGtgSvg("components/KeyPort_Night.svg"));
 	}
 };
 
 struct gtgScrewUp : ThemedSvgScrew {
 	gtgScrewUp() {
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/ScrewUp.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/components/ScrewUp_Night.svg")));
+		addFrame(loadGtgSvg("components/ScrewUp.svg"));
+		addFrame(loadGtgSvg("components/ScrewUp_Night.svg"));
 	}
 };
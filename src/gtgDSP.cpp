@@ -0,0 +1,52 @@
+#include "gtgDSP.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+// the ring thread polls every few milliseconds, so a ring is offered soon after the audio thread asks for it
+// it starts with the first ring and is joined when the last ring goes, so no thread outlives the modules
+
+static std::mutex ring_control;   // serializes starting and stopping the thread
+static std::mutex ring_mutex;   // guards the services, held while servicing them
+static std::condition_variable ring_wake;
+static std::vector<RingService*> ring_services;
+static std::thread ring_thread;
+static bool ring_stopping = false;
+
+static void runRingThread() {
+	std::unique_lock<std::mutex> lock(ring_mutex);
+	while (!ring_stopping) {
+		for (RingService *ring_service : ring_services) ring_service->serve(ring_service);
+		ring_wake.wait_for(lock, std::chrono::milliseconds(2));
+	}
+}
+
+void RingService::registerService() {
+	std::lock_guard<std::mutex> control(ring_control);
+	{
+		std::lock_guard<std::mutex> lock(ring_mutex);
+		ring_services.push_back(this);
+		ring_stopping = false;
+	}
+	if (!ring_thread.joinable()) ring_thread = std::thread(runRingThread);
+}
+
+RingService::~RingService() {
+	unregisterService();
+}
+
+void RingService::unregisterService() {
+	std::lock_guard<std::mutex> control(ring_control);
+	{
+		std::lock_guard<std::mutex> lock(ring_mutex);
+		auto found = std::find(ring_services.begin(), ring_services.end(), this);
+		if (found == ring_services.end()) return;
+		ring_services.erase(found);
+		if (!ring_services.empty()) return;
+		ring_stopping = true;
+	}
+	ring_wake.notify_all();
+	if (ring_thread.joinable()) ring_thread.join();
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "plugin.hpp"
+#include <vector>
 
 
 // simple fader for smoothing on off states and setting a common gain
@@ -64,6 +65,70 @@ private:
 };
 
 
+// a simple slew limiter that uses milliseconds
+
+struct SimpleSlewer {
+
+	float value = 0.f;
+
+	float slew(float new_value) {
+		if (new_value != value) {
+			if (new_value > value) {
+				value = std::fmin(value + delta, new_value);
+			} else {
+				value = std::fmax(value - delta, new_value);
+			}
+		}
+		return value;
+	}
+
+	void setSlewSpeed(int speed) {
+		float sampleRate = APP->engine->getSampleRate();
+		delta = 1.f/(sampleRate * 0.001f * (float)speed);   // milliseconds from 0 to 1
+	}
+
+private:
+
+	float delta = 0.0005f;
+};
+
+
+// slews four values at once, linear like SimpleSlewer
+struct VectorSlewer {
+
+	simd::float_4 value = 0.f;
+
+	simd::float_4 slew(simd::float_4 new_value) {
+		value += simd::clamp(new_value - value, -delta, delta);
+		return value;
+	}
+
+	void setSlewSpeed(int speed) {
+		float sampleRate = APP->engine->getSampleRate();
+		delta = 1.f/(sampleRate * 0.001f * (float)speed);   // milliseconds from 0 to 1
+	}
+
+private:
+
+	float delta = 0.0005f;
+};
+
+
+// efficient constant power pan law that adjusts center to 1.f and sounds nice
+inline void constantPanLevels(float position, float *levels) {
+	float pan_angle = (position + 1.f) * 0.5f;
+	levels[0] = sin((1.f - pan_angle) * M_PI_2) * M_SQRT2;   // left level
+	levels[1] = sin(pan_angle * M_PI_2) * M_SQRT2;   // right level
+}
+
+// the same pan law for four pan positions at a time
+inline void constantPanLevels(simd::float_4 position, simd::float_4 *levels) {
+	simd::float_4 pan_angle = (position + 1.f) * 0.5f;
+	levels[0] = simd::sin((1.f - pan_angle) * M_PI_2) * M_SQRT2;   // left levels
+	levels[1] = simd::sin(pan_angle * M_PI_2) * M_SQRT2;   // right levels
+}
+
+
 // constant power pan with optional smoothing
 // set pan position with setPan() and then get levels for each channel with getLevel()
 
@@ -103,38 +168,395 @@ private:
 
 	float delta = 0.0005f;
 
-	// efficient constant power pan law that adjusts center to 1.f and sounds nice
 	void setLevels(float final_position) {
-		float pan_angle = (final_position + 1.f) * 0.5f;
-		levels[0] = sin((1.f - pan_angle) * M_PI_2) * M_SQRT2;   // left level
-		levels[1] = sin(pan_angle * M_PI_2) * M_SQRT2;   // right level
+		constantPanLevels(final_position, levels);
 	}
 };
 
 
-// a simple slew limiter that uses milliseconds
+// spread patterns for polyphonic voices
+enum SpreadPatterns {
+	SPREAD_LINEAR,   // from the pan position toward one edge
+	SPREAD_ALTERNATE,   // voices alternate left and right of the pan position
+	SPREAD_RANDOM,   // seeded random position for each voice
+	SPREAD_CENTER_OUT,   // first voice at the pan position, then outward on alternate sides
+	SPREAD_CLUSTERED,   // three tight groups at the pan position and the two edges
+	SPREAD_PATTERNS
+};
 
-struct SimpleSlewer {
+// repeatable random position from -1 to 1 for a voice
+inline float spreadRandom(uint32_t seed, int voice) {
+	uint32_t h = seed ^ ((uint32_t)(voice + 1) * 2654435761u);
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return (h >> 8) * (2.f / 16777216.f) - 1.f;
+}
 
-	float value = 0.f;
 
-	float slew(float new_value) {
-		if (new_value != value) {
-			if (new_value > value) {
-				value = std::fmin(value + delta, new_value);
-			} else {
-				value = std::fmax(value - delta, new_value);
+// constant power pan for each voice of a polyphonic cable
+// set pan and spread with setSpread() and then mix voices to stereo four at a time with mix()
+// levels are a cached 16x2 gain matrix, rebuilt only when pan, spread, channels, reverse or pattern change
+// levels slew to a rebuilt matrix, call slewLevels() once a sample before reading levels or calling mix()
+
+struct PolyPan {
+
+	simd::float_4 levels[2][4] = {};   // left and right levels for 16 voices
+	float positions[16] = {};   // pan positions of the voices before reversing
+	int channels = 0;
+	bool summing = true;   // all voices share one position when there is no spread, so they are summed and panned once
+	bool settling = false;   // levels are still slewing to the last matrix
+
+	void setSpread(float pan, float spread, int new_channels, bool reverse = false, int pattern = SPREAD_LINEAR, uint32_t seed = 0) {
+		if (pan == last_pan && spread == last_spread && new_channels == channels && reverse == last_reverse
+			&& pattern == last_pattern && seed == last_seed) return;   // recalculates only after a change
+		bool first = (last_pan < -1.f);   // the first matrix is used at once
+		last_pan = pan;
+		last_spread = spread;
+		last_reverse = reverse;
+		last_pattern = pattern;
+		last_seed = seed;
+		channels = new_channels;
+		summing = (spread == 0.f || channels < 2);
+
+		for (int c = 0; c < 16; c++) {
+			positions[c] = pan;
+			if (c < channels && channels > 1) positions[c] = spreadPosition(pan, spread, c, pattern, seed);
+		}
+
+		for (int c = 0; c < 16; c++) {
+			float voice_levels[2] = {0.f, 0.f};   // unused voices stay silent
+			if (c < channels) constantPanLevels(positions[reverse ? channels - 1 - c : c], voice_levels);
+			target_levels[0][c / 4][c % 4] = voice_levels[0];
+			target_levels[1][c / 4][c % 4] = voice_levels[1];
+		}
+
+		if (first) {
+			for (int i = 0; i < 2; i++) {
+				for (int b = 0; b < 4; b++) {
+					levels[i][b] = target_levels[i][b];
+					slewers[i][b].value = target_levels[i][b];
+				}
 			}
 		}
-		return value;
+		settling = !first;
 	}
 
-	void setSlewSpeed(int speed) {
-		float sampleRate = APP->engine->getSampleRate();
-		delta = 1.f/(sampleRate * 0.001f * (float)speed);   // milliseconds from 0 to 1
+	// steps the levels toward the last matrix, stops once every level has arrived
+	void slewLevels() {
+		if (!settling) return;
+		settling = false;
+		for (int i = 0; i < 2; i++) {
+			for (int b = 0; b < 4; b++) {
+				levels[i][b] = slewers[i][b].slew(target_levels[i][b]);
+				if (simd::movemask(levels[i][b] != target_levels[i][b])) settling = true;
+			}
+		}
+	}
+
+	void setSlewSpeed(int speed) {   // milliseconds for a voice level from 0 to 1
+		for (int i = 0; i < 2; i++) {
+			for (int b = 0; b < 4; b++) {
+				slewers[i][b].setSlewSpeed(speed);
+			}
+		}
+	}
+
+	void mix(Input &input, float *stereo_out, int active_voices = 0xFFFF) {   // voices not in active_voices are skipped
+		if (summing && !settling) {   // voices are mixed one by one while their levels still differ
+			float sum_in = input.getVoltageSum();
+			stereo_out[0] = sum_in * levels[0][0][0];
+			stereo_out[1] = sum_in * levels[1][0][0];
+			return;
+		}
+		simd::float_4 sums[2] = {};
+		for (int b = 0; b < (channels + 3) / 4; b++) {
+			if (!((active_voices >> (b * 4)) & 0xF)) continue;
+			simd::float_4 voices = input.getVoltageSimd<simd::float_4>(b * 4);
+			sums[0] += voices * levels[0][b];
+			sums[1] += voices * levels[1][b];
+		}
+		for (int c = 0; c < 2; c++) {
+			stereo_out[c] = sums[c][0] + sums[c][1] + sums[c][2] + sums[c][3];
+		}
 	}
 
 private:
 
-	float delta = 0.0005f;
+	simd::float_4 target_levels[2][4] = {};
+	VectorSlewer slewers[2][4];
+	float last_pan = -2.f;   // out of range to force the first calculation
+	float last_spread = -2.f;
+	bool last_reverse = false;
+	int last_pattern = SPREAD_LINEAR;
+	uint32_t last_seed = 0;
+
+	// spread is a portion of the field between the pan position and hard left or hard right
+	// negative spread goes left for linear spreads, and swaps sides for the other patterns
+	float spreadPosition(float pan, float spread, int c, int pattern, uint32_t seed) {
+		float right_field = (1.f - pan) * std::abs(spread);
+		float left_field = (pan + 1.f) * std::abs(spread);
+		float side = (spread < 0) ? -1.f : 1.f;
+		float offset = 0.f;   // -1 to 1 across the field
+
+		switch (pattern) {
+		default:
+		case SPREAD_LINEAR:
+			offset = side * (float)c / (float)(channels - 1);
+			break;
+		case SPREAD_ALTERNATE:
+			offset = (c % 2) ? -side : side;
+			break;
+		case SPREAD_RANDOM:
+			offset = spreadRandom(seed, c);
+			break;
+		case SPREAD_CENTER_OUT: {
+			int steps = channels / 2;   // voices on each side
+			offset = ((c % 2) ? side : -side) * (float)((c + 1) / 2) / (float)steps;
+			break;
+		}
+		case SPREAD_CLUSTERED: {
+			int group = c % 3;   // center, right and left groups
+			int member = c / 3;
+			float jitter = ((member % 2) ? -0.08f : 0.08f) * (float)((member + 1) / 2);
+			float groups[3] = {0.f, 0.8f, -0.8f};
+			offset = clamp(groups[group] * side + jitter, -1.f, 1.f);
+			break;
+		}
+		}
+
+		return pan + offset * ((offset < 0) ? left_field : right_field);
+	}
 };
+
+
+// rings for the audio thread, allocated and freed on a shared ring thread that runs while any ring exists
+// the audio thread asks for a size with prepare() and takes a ring once it is offered, so process() never allocates or frees,
+// and memory follows the delay in use instead of the longest possible delay
+
+struct RingService {
+
+	void (*serve)(RingService *ring_service) = NULL;   // called on the ring thread
+
+	~RingService();
+
+	void registerService();   // call last in derived constructors, the ring thread may serve right away
+	void unregisterService();   // waits out a service in progress, call first in derived destructors
+};
+
+
+// power of two ring handed over with atomic pointers
+// a ring that is replaced keeps being written and read until the new one has as much history
+
+template <typename T>
+struct HandoffRing : RingService {
+
+	HandoffRing() {
+		serve = [](RingService *ring_service) {((HandoffRing*)ring_service)->service();};
+		registerService();
+	}
+
+	~HandoffRing() {
+		unregisterService();
+		delete ring;
+		delete previous;
+		delete offered.load();
+		delete retired.load();
+	}
+
+	// audio thread: ask for a ring holding max_delay steps, returns true when one can be written
+	bool prepare(long max_delay) {
+		wanted.store(max_delay + 2, std::memory_order_relaxed);   // readFrac reads one step past the delay
+		if (!previous) {
+			Ring *next = offered.load(std::memory_order_acquire);
+			if (next) {
+				held_size.store(next->data.size(), std::memory_order_relaxed);
+				next = offered.exchange(NULL, std::memory_order_acq_rel);
+			}
+			if (next) {
+				previous = ring;
+				ring = next;
+				ring_bytes.store(bytesOf(ring) + bytesOf(previous), std::memory_order_relaxed);
+			}
+		}
+		if (previous && ring->recorded >= std::min(previous->recorded, max_delay + 2)) retire(previous);
+		return ring != NULL;
+	}
+
+	// audio thread: give the rings back to the ring thread to free
+	void release() {
+		wanted.store(0, std::memory_order_relaxed);
+		if (previous) retire(previous);
+		if (!previous && ring) retire(ring);
+	}
+
+	void reset() {   // audio thread: forget recorded steps, keeps the rings
+		if (ring) ring->recorded = 0;
+		if (previous) previous->recorded = 0;
+	}
+
+	void write(T value) {
+		ring->write(value);
+		if (previous) previous->write(value);
+	}
+
+	float readFrac(float delay) {   // fractional delay with linear interpolation, clamped to the ring size
+		Ring *source = previous ? previous : ring;
+		delay = std::fmin(delay, (float)(source->mask - 1));
+		long whole = (long)delay;
+		float frac = delay - (float)whole;
+		float newer = source->data[(source->write_i - whole) & source->mask];
+		float older = source->data[(source->write_i - whole - 1) & source->mask];
+		return newer + (older - newer) * frac;
+	}
+
+	long recorded() {   // steps that can be read, 0 without a ring
+		if (previous) return previous->recorded;
+		return ring ? ring->recorded : 0;
+	}
+
+	long bytes() {
+		return ring_bytes.load(std::memory_order_relaxed);
+	}
+
+	// ring thread: free a retired ring and offer one sized for the delay the audio thread asked for
+	void service() {
+		delete retired.exchange(NULL, std::memory_order_acquire);
+		long want = wanted.load(std::memory_order_relaxed);
+		if (want <= 0) {
+			delete offered.exchange(NULL, std::memory_order_acquire);   // not needed any more
+			return;
+		}
+		if (offered.load(std::memory_order_relaxed)) return;   // not taken yet
+		long held = held_size.load(std::memory_order_relaxed);
+		if (held >= want && held <= want * 4) return;   // fits without much waste
+		long ring_size = 1;
+		while (ring_size < want) ring_size <<= 1;
+		if (ring_size == held) return;
+		offered.store(new Ring(ring_size), std::memory_order_release);
+	}
+
+private:
+
+	struct Ring {
+		std::vector<T> data;
+		long mask;
+		long write_i = 0;
+		long recorded = 0;   // steps written, up to the ring size
+
+		Ring(long ring_size) : data(ring_size, T(0)), mask(ring_size - 1) {}
+
+		void write(T value) {
+			write_i = (write_i + 1) & mask;
+			data[write_i] = value;
+			if (recorded <= mask) recorded++;
+		}
+	};
+
+	// audio thread: hand a ring to the ring thread, waits for the next call while the last one is not freed yet
+	void retire(Ring *&held) {
+		if (retired.load(std::memory_order_acquire)) return;
+		retired.store(held, std::memory_order_release);
+		held = NULL;
+		if (!ring) held_size.store(0, std::memory_order_relaxed);
+		ring_bytes.store(bytesOf(ring) + bytesOf(previous), std::memory_order_relaxed);
+	}
+
+	static long bytesOf(Ring *r) {
+		return r ? r->data.size() * sizeof(T) : 0;
+	}
+
+	Ring *ring = NULL;   // owned by the audio thread
+	Ring *previous = NULL;   // replaced ring, still read until ring has as much history
+	std::atomic<Ring*> offered{NULL};   // made by the ring thread, taken by the audio thread
+	std::atomic<Ring*> retired{NULL};   // given up by the audio thread, freed by the ring thread
+	std::atomic<long> wanted{0};   // ring size the audio thread needs, 0 when it needs none
+	std::atomic<long> held_size{0};
+	std::atomic<long> ring_bytes{0};
+};
+
+
+// pan follow history of 16 bit positions on a handoff ring
+// no ring is held while nothing is following
+
+struct PanHistory : HandoffRing<int16_t> {
+
+	void writePosition(float position) {
+		write((int16_t)std::round(math::clamp(position, -4.f, 4.f) * scale));
+	}
+
+	float readPosition(float delay) {   // delay in history steps, needs a recorded size of delay + 1
+		return readFrac(delay) * (1.f / scale);
+	}
+
+private:
+
+	const float scale = 8191.f;   // pan positions from -4 to 4
+};
+
+
+// bus cables carry one rig of three stereo buses on 6 channels, or two rigs (A and B) on 12 channels
+
+const int RIG_CHANNELS = 6;
+const int DUAL_RIG_CHANNELS = 12;
+
+// all channels of a bus cable, processed four channels at a time
+struct BusFrame {
+
+	simd::float_4 v[3] = {};
+
+	void load(Input &input) {
+		if (input.getChannels() == 1) {   // spread a mono cable like getPolyVoltage()
+			for (int i = 0; i < 3; i++) v[i] = input.getVoltage();
+		} else {
+			for (int i = 0; i < 3; i++) v[i] = input.getVoltageSimd<simd::float_4>(i * 4);
+		}
+	}
+
+	void store(Output &output, int channels) {
+		for (int i = 0; i < 3; i++) output.setVoltageSimd(v[i], i * 4);
+		output.setChannels(channels);
+	}
+
+	// add three stereo buses of sends to rig 0 (A) or rig 1 (B)
+	void addRig(int rig, const float *sends) {
+		alignas(16) float rig_sends[DUAL_RIG_CHANNELS] = {};
+		for (int c = 0; c < RIG_CHANNELS; c++) {
+			rig_sends[(rig * RIG_CHANNELS) + c] = sends[c];
+		}
+		for (int i = 0; i < 3; i++) v[i] += simd::float_4::load(&rig_sends[i * 4]);
+	}
+
+	void getRig(int rig, float *buses) {
+		for (int c = 0; c < RIG_CHANNELS; c++) {
+			int bus_channel = (rig * RIG_CHANNELS) + c;
+			buses[c] = v[bus_channel / 4][bus_channel % 4];
+		}
+	}
+
+	void setRig(int rig, const float *buses) {
+		for (int c = 0; c < RIG_CHANNELS; c++) {
+			int bus_channel = (rig * RIG_CHANNELS) + c;
+			v[bus_channel / 4][bus_channel % 4] = buses[c];
+		}
+	}
+};
+
+// keep 6 channels unless rig B is used here or further up the chain
+inline int busChannels(Input &input, int rig) {
+	if (rig > 0 || input.getChannels() > RIG_CHANNELS) return DUAL_RIG_CHANNELS;
+	return RIG_CHANNELS;
+}
+
+// forward a whole bus cable with one vector copy when a module is bypassed
+inline void bypassBus(Input &input, Output &output) {
+	BusFrame bus_frame;
+	bus_frame.load(input);
+	bus_frame.store(output, busChannels(input, 0));
+}
+
+
+// delay line on a handoff ring sized for the delay in use
+struct DelayRing : HandoffRing<float> {};
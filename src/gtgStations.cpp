@@ -0,0 +1,62 @@
+#include "gtgStations.hpp"
+
+
+const char *station_names[STATION_COUNT] = {"Central", "Union", "Grand", "Harbor", "Market", "Summit", "Valley", "Terminal"};
+
+static StationSlot station_slots[STATION_SLOTS];
+static std::atomic<int> station_slots_used{0};   // slots above this have never been taken
+
+// take a free slot for a publishing module, or -1 when all slots are taken
+int acquireStationSlot(const void *network) {
+	for (int s = 0; s < STATION_SLOTS; s++) {
+		bool free_slot = false;
+		if (station_slots[s].in_use.compare_exchange_strong(free_slot, true)) {
+			for (int i = 0; i < 2; i++) {
+				station_slots[s].stamps[i].store(-1, std::memory_order_relaxed);
+			}
+			station_slots[s].network.store(network, std::memory_order_relaxed);
+			int used = station_slots_used.load();
+			while (used < s + 1 && !station_slots_used.compare_exchange_weak(used, s + 1)) {}
+			return s;
+		}
+	}
+	return -1;
+}
+
+void releaseStationSlot(int slot) {
+	station_slots[slot].station.store(-1, std::memory_order_relaxed);
+	station_slots[slot].in_use.store(false);
+}
+
+void writeStationSlot(int slot, int station, int64_t frame, BusFrame &bus_frame, int channels) {
+	StationSlot &station_slot = station_slots[slot];
+	int b = frame & 1;
+	for (int c = 0; c < DUAL_RIG_CHANNELS; c++) {
+		station_slot.buses[b][c].store(bus_frame.v[c / 4][c % 4], std::memory_order_relaxed);
+	}
+	station_slot.channels[b].store(channels, std::memory_order_relaxed);
+	station_slot.station.store(station, std::memory_order_relaxed);
+	station_slot.stamps[b].store(frame, std::memory_order_release);
+}
+
+int readStation(const void *network, int station, int64_t frame, BusFrame &bus_frame) {
+	int64_t last_frame = frame - 1;   // one sample of latency
+	int b = last_frame & 1;
+	int channels = 0;
+	int used = station_slots_used.load(std::memory_order_relaxed);
+	for (int s = 0; s < used; s++) {
+		StationSlot &station_slot = station_slots[s];
+		if (station_slot.station.load(std::memory_order_relaxed) != station) continue;
+		if (station_slot.network.load(std::memory_order_relaxed) != network) continue;   // another engine in this process
+		if (station_slot.stamps[b].load(std::memory_order_acquire) != last_frame) continue;   // publisher did not write last frame
+		alignas(16) float buses[DUAL_RIG_CHANNELS];
+		for (int c = 0; c < DUAL_RIG_CHANNELS; c++) {
+			buses[c] = station_slot.buses[b][c].load(std::memory_order_relaxed);
+		}
+		for (int i = 0; i < 3; i++) {
+			bus_frame.v[i] += simd::float_4::load(&buses[i * 4]);
+		}
+		channels = std::max(channels, station_slot.channels[b].load(std::memory_order_relaxed));
+	}
+	return channels;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "plugin.hpp"
+#include "gtgDSP.hpp"
+#include <atomic>
+
+
+// bus stations carry bus chains across the patch without cables
+// each publishing module owns a slot with two frames of buses, written on even and odd engine frames
+// receivers read the frame before their own, so every station has exactly one sample of latency
+// slots are written and read with relaxed atomics and stamped with the engine frame, nothing ever waits
+// slots are keyed by engine, so Rack instances sharing a process (Cardinal) never hear each other's stations
+
+const int STATION_COUNT = 8;
+const int STATION_SLOTS = 64;
+
+extern const char *station_names[STATION_COUNT];
+
+struct StationSlot {
+	std::atomic<bool> in_use{false};
+	std::atomic<const void*> network{NULL};   // engine of the publishing module
+	std::atomic<int> station{-1};
+	std::atomic<int64_t> stamps[2];
+	std::atomic<int> channels[2];
+	std::atomic<float> buses[2][DUAL_RIG_CHANNELS];
+};
+
+int acquireStationSlot(const void *network);
+
+void releaseStationSlot(int slot);
+
+void writeStationSlot(int slot, int station, int64_t frame, BusFrame &bus_frame, int channels);
+
+int readStation(const void *network, int station, int64_t frame, BusFrame &bus_frame);   // adds the station to bus_frame and returns its channels
+
+// the engine a module runs on, taken when the module is made
+inline const void *stationNetwork() {
+	return APP->engine;
+}
+
+
+// publishes a module's bus output to a station
+struct StationPublisher {
+
+	int station = -1;   // -1 when not publishing
+	const void *network = stationNetwork();
+
+	~StationPublisher() {
+		if (slot >= 0) releaseStationSlot(slot);
+	}
+
+	void publish(int64_t frame, BusFrame &bus_frame, int channels) {
+		if (station < 0) {
+			if (slot >= 0) {   // stopped publishing
+				releaseStationSlot(slot);
+				slot = -1;
+			}
+			return;
+		}
+		if (slot < 0) {
+			slot = acquireStationSlot(network);
+			if (slot < 0) return;   // all slots are taken
+		}
+		writeStationSlot(slot, station, frame, bus_frame, channels);
+	}
+
+private:
+
+	int slot = -1;
+};
+
+
+// station selection menu items
+struct StationItem : MenuItem {
+	int *station = NULL;
+	int station_index = -1;
+	void onAction(const event::Action &e) override {
+		*station = station_index;
+	}
+};
+
+struct StationsItem : MenuItem {
+	int *station = NULL;
+	int *other_station = NULL;   // the module's station in the other direction, not offered as it would feed back
+	std::string other_text;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		for (int i = -1; i < STATION_COUNT; i++) {
+			StationItem *station_item = new StationItem;
+			station_item->text = (i < 0) ? "None (default)" : station_names[i];
+			station_item->rightText = CHECKMARK(*station == i);
+			station_item->station = station;
+			station_item->station_index = i;
+			if (other_station && i >= 0 && *other_station == i) {
+				station_item->rightText = other_text;
+				station_item->disabled = true;
+			}
+			menu->addChild(station_item);
+		}
+		return menu;
+	}
+};
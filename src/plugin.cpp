@@ -1,16 +1,18 @@
 #include "plugin.hpp"
+#include "gtgComponents.hpp"
 
 
 Plugin *pluginInstance;
 
 // variables used by all modules
-bool audition_mixer = false;
-bool audition_depot = false;
-int gtg_default_theme = 0;
+std::atomic<int> gtg_default_theme{0};
 
 void init(Plugin *p) {
 	pluginInstance = p;
 
+	// read plugin settings once for all modules
+	loadGtgPluginSettings();
+
 	// Add modules here
 	// p->addModel(modelMyModule);
 	p->addModel(modelGigBus);
@@ -22,6 +24,8 @@ void init(Plugin *p) {
 	p->addModel(modelRoad);
 	p->addModel(modelEnterBus);
 	p->addModel(modelExitBus);
+	p->addModel(modelConsole);
+	p->addModel(modelRoad16);
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
 }
@@ -1,15 +1,14 @@
 #pragma once
 #include <rack.hpp>
+#include <atomic>
 
 using namespace rack;
 
 // Declare the Plugin, defined in plugin.cpp
 extern Plugin *pluginInstance;
 
-// variables used by all plugins
-extern bool audition_mixer;
-extern bool audition_depot;
-extern int gtg_default_theme;
+// variables used by all plugins, auditions are in gtgAudition.hpp
+extern std::atomic<int> gtg_default_theme;
 
 // Declare each Model, defined in each module source file
 // extern Model *modelMyModule;
@@ -22,3 +21,5 @@ extern Model *modelBusRoute;
 extern Model *modelRoad;
 extern Model *modelEnterBus;
 extern Model *modelExitBus;
+extern Model *modelConsole;
+extern Model *modelRoad16;